@@ -4,9 +4,21 @@ namespace a {
 
 #define MEMORY_RESERVE_DEFAULT_SIZE 1_mb
 
+konst u32 ARENA_LOG_HUGE_PAGE_SIZE = 21;  // 2mb
+
+konst usize ARENA_SCRATCH_DEFAULT_SIZE = 64_mb;
+
+struct ArenaScratchOwner {
+    Arena arenas[2];
+    ~ArenaScratchOwner();
+};
+
 global thread_local Arena* g_arena_scratch[2];
+global thread_local ArenaScratchOwner g_arena_scratch_owner;
+global AtomicVal<usize> g_arena_scratch_default_size = {ARENA_SCRATCH_DEFAULT_SIZE};
 u32 Arena::log_reserve_page_size;
 u32 Arena::log_commit_page_size;
+bool Arena::transparent_huge_pages_enabled;
 
 // -----------------------------------------------------------------------------
 
@@ -17,6 +29,19 @@ void Arena::global_init() {
 
     Arena::log_reserve_page_size = log_page_size;
     Arena::log_commit_page_size = log_page_size;
+
+#if !PLATFORM_APPLE
+    // madvise(MADV_HUGEPAGE) succeeds even when THP is switched off system-wide,
+    // so check the sysfs knob to be able to report the mode honestly.
+    Arena::transparent_huge_pages_enabled = false;
+    FILE* thp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "rb");
+    if (thp) {
+        char setting[64] = {};
+        fread(setting, 1, sizeof(setting) - 1, thp);
+        fclose(thp);
+        Arena::transparent_huge_pages_enabled = !strstr(setting, "[never]");
+    }
+#endif
 }
 
 void Arena::thread_init(Arena* scratch0, Arena* scratch1) {
@@ -24,30 +49,132 @@ void Arena::thread_init(Arena* scratch0, Arena* scratch1) {
     g_arena_scratch[1] = scratch1;
 }
 
+void Arena::set_default_scratch_size(usize reserve_size) {
+    ::std::atomic_store_explicit(g_arena_scratch_default_size.ptr(), reserve_size, ::std::memory_order_relaxed);
+}
+
+void Arena::thread_init_scratch(usize reserve_size) {
+    AssertM(!g_arena_scratch[0], "this thread already has scratch arenas");
+
+    if (reserve_size == 0) {
+        reserve_size = ::std::atomic_load_explicit(g_arena_scratch_default_size.ptr(), ::std::memory_order_relaxed);
+    }
+    for (u32 i = 0; i < 2; ++i) {
+        Arena* arena = &g_arena_scratch_owner.arenas[i];
+        arena->create(reserve_size);
+        g_arena_scratch[i] = arena;
+    }
+}
+
+ArenaScratchOwner::~ArenaScratchOwner() {
+    for (u32 i = 0; i < 2; ++i) {
+        if (!arenas[i].cur) continue;
+        if (g_arena_scratch[i] == &arenas[i]) g_arena_scratch[i] = nullptr;
+        arenas[i].destroy();
+    }
+}
+
 // -----------------------------------------------------------------------------
 
-void Arena::create(usize reserve_size) {
+void Arena::create(usize reserve_size, ArenaPageMode page_mode) {
     DebugAssert(!cur);
 
     if (reserve_size == 0) {
         reserve_size = MEMORY_RESERVE_DEFAULT_SIZE;
-    } else {
-        usize mem_reserve_size = 1 << log_reserve_page_size;
-        usize pages = (reserve_size % mem_reserve_size == 0 ? 0 : 1) + reserve_size / mem_reserve_size;
-        reserve_size = mem_reserve_size * pages;
     }
 
-    u8* ptr = mem_reserve(reserve_size);
+    // huge page arenas reserve and commit in whole 2mb granules so that every
+    // commit can be backed by a huge page.
+    u32 log_granule_size = page_mode == ARENA_PAGES_DEFAULT ? log_reserve_page_size : ARENA_LOG_HUGE_PAGE_SIZE;
+    usize mem_reserve_size = (usize)1 << log_granule_size;
+    usize pages = (reserve_size % mem_reserve_size == 0 ? 0 : 1) + reserve_size / mem_reserve_size;
+    reserve_size = mem_reserve_size * pages;
+
+    u8* ptr = mem_reserve(reserve_size, &page_mode);
 
     base = ptr,
+    zero_mark = ptr,
     pages_committed = 0,
     reserved_size = reserve_size,
+    commit_chunk_pages = 1,
+    decommit_high_water_pages = 0,
+    decommit_low_water_pages = 0,
+    log_commit_size = page_mode == ARENA_PAGES_DEFAULT ? log_commit_page_size : ARENA_LOG_HUGE_PAGE_SIZE,
+    mode = page_mode,
+    commit_policy = ARENA_COMMIT_CHUNKED,
+    prefault = false,
+    decommit_lazy = false,
     cur = base;
 }
 
+ArenaStats Arena::stats() {
+    ArenaStats ret = {};
+#if ARENA_STATS
+    ret = counters;
+#endif
+    ret.bytes_reserved = reserved_size;
+    ret.bytes_committed = pages_committed == USIZE_MAX ? reserved_size : pages_committed << log_commit_size;
+    return ret;
+}
+
+void Arena::set_commit_policy(ArenaCommitPolicy policy, usize chunk_size, bool prefault_pages) {
+    DebugAssert(cur);
+    if (pages_committed == USIZE_MAX) return;
+
+    usize commit_size = (usize)1 << log_commit_size;
+    commit_chunk_pages = chunk_size == 0 ? 1 : (chunk_size + commit_size - 1) >> log_commit_size;
+    commit_policy = policy;
+    prefault = prefault_pages;
+
+    if (policy == ARENA_COMMIT_ALL) {
+        commit_pages(reserved_size >> log_commit_size);
+    }
+}
+
+void Arena::set_decommit_policy(usize high_water, usize low_water, bool lazy) {
+    DebugAssert(cur);
+    DebugAssert(high_water == 0 || low_water <= high_water);
+    if (pages_committed == USIZE_MAX) return;
+
+    usize commit_size = (usize)1 << log_commit_size;
+    decommit_high_water_pages = (high_water + commit_size - 1) >> log_commit_size;
+    decommit_low_water_pages = (low_water + commit_size - 1) >> log_commit_size;
+    decommit_lazy = lazy;
+}
+
+void Arena::enable_chaining(usize block_size) {
+    DebugAssert(cur);
+    if (pages_committed == USIZE_MAX) return;
+    chain_block_size = block_size == 0 ? reserved_size : block_size;
+}
+
+void Arena::trim(usize keep_size) {
+    DebugAssert(cur);
+    if (pages_committed == USIZE_MAX) return;
+
+    usize keep = max((usize)(cur - base), keep_size);
+    usize keep_pages = keep == 0 ? 0 : 1 + ((keep - 1) >> log_commit_size);
+    if (keep_pages >= pages_committed) return;
+
+    usize keep_bytes = keep_pages << log_commit_size;
+    usize release_bytes = (pages_committed - keep_pages) << log_commit_size;
+    pages_committed = keep_pages;
+
+    if (!mem_decommit(base + keep_bytes, release_bytes)) return;
+#if ARENA_STATS
+    counters.decommit_calls++;
+#endif
+
+    // lazily freed pages may come back with their old contents.
+    if (!decommit_lazy) {
+        zero_mark = min(zero_mark, base + keep_bytes);
+    }
+}
+
 Arena Arena::make_with_buffer(u8* bytes, usize count) {
     Arena ret = {};
     ret.base = bytes;
+    ret.zero_mark = bytes + count;
     ret.reserved_size = count;
     ret.pages_committed = USIZE_MAX;
     ret.cur = bytes;
@@ -56,11 +183,17 @@ Arena Arena::make_with_buffer(u8* bytes, usize count) {
 
 void Arena::destroy() {
     if (cur && pages_committed != USIZE_MAX) {
+        while (chain) pop_block();
         mem_release(base, reserved_size);
     }
     ZeroStruct(this);
 }
 
+void Arena::clear() {
+    while (chain) pop_block();
+    rewind(base);
+}
+
 void Arena::max_align() {
     DebugAssert(cur);
     konst usize MAX_ALIGN = 32;
@@ -77,16 +210,18 @@ forall(T) T* Arena::push() {
     if constexpr (sizeof(T) > 1) {
         cur = (u8*)(((usize)cur + (alignof(T) - 1)) & ~(alignof(T) - 1));
     }
-    u8* ret = cur;
-    bump(sizeof(T));
-    return (T*)memset(ret, 0, sizeof(T));
+    u8* clean;
+    u8* ret = bump(sizeof(T), &clean);
+    if (ret < clean) memset(ret, 0, sizeof(T));
+    return (T*)ret;
 }
 
 forall(T) T* Arena::push_unaligned() {
     DebugAssert(cur);
-    u8* ret = cur;
-    bump(sizeof(T));
-    return (T*)memset(ret, 0, sizeof(T));
+    u8* clean;
+    u8* ret = bump(sizeof(T), &clean);
+    if (ret < clean) memset(ret, 0, sizeof(T));
+    return (T*)ret;
 }
 
 forall(T) Slice<T> Arena::push_many(usize count) {
@@ -95,58 +230,281 @@ forall(T) Slice<T> Arena::push_many(usize count) {
     if constexpr (sizeof(T) > 1) {
         cur = (u8*)(((usize)cur + (alignof(T) - 1)) & ~(alignof(T) - 1));
     }
-    u8* ret = cur;
-    usize size = sizeof(T) * count;
-    bump(size);
-    return Slice<T>{(T*)memset(ret, 0, size), count};
+    return Slice<T>{(T*)bump_zeroed(sizeof(T) * count), count};
 }
 
 forall(T) Slice<T> Arena::push_many_unaligned(usize count) {
     DebugAssert(cur);
     if (count == 0) return Slice<T>{};
-    u8* ret = cur;
-    usize size = sizeof(T) * count;
-    bump(size);
-    return Slice<T>{(T*)memset(ret, 0, size), count};
+    return Slice<T>{(T*)bump_zeroed(sizeof(T) * count), count};
+}
+
+forall(T) T* Arena::push_uninit() {
+    DebugAssert(cur);
+    if constexpr (sizeof(T) > 1) {
+        cur = (u8*)(((usize)cur + (alignof(T) - 1)) & ~(alignof(T) - 1));
+    }
+    return (T*)bump(sizeof(T));
+}
+
+forall(T) T* Arena::push_unaligned_uninit() {
+    DebugAssert(cur);
+    return (T*)bump(sizeof(T));
+}
+
+forall(T) Slice<T> Arena::push_many_uninit(usize count) {
+    DebugAssert(cur);
+    if (count == 0) return Slice<T>{};
+    if constexpr (sizeof(T) > 1) {
+        cur = (u8*)(((usize)cur + (alignof(T) - 1)) & ~(alignof(T) - 1));
+    }
+    return Slice<T>{(T*)bump(sizeof(T) * count), count};
 }
 
 void Arena::push_bytes(void* start, usize size) {
     DebugAssert(cur);
     if (size == 0) return;
-    u8* ret = cur;
-    bump(size);
+    u8* ret = bump(size);
     MemCopy(ret, start, size);
 }
 
-void Arena::bump(usize size) {
-    cur += size;
+// only the part of the range below the known-zero mark needs clearing.
+u8* Arena::bump_zeroed(usize size) {
+    u8* clean;
+    u8* ret = bump(size, &clean);
+    if (ret < clean) memset(ret, 0, min(size, (usize)(clean - ret)));
+    return ret;
+}
 
-    if (pages_committed == USIZE_MAX) {
-        AssertM(cur - base < reserved_size, "arena overran backing buffer");
-        return;
+// returns the start of the bumped range, which only differs from the cursor
+// passed in when a shared arena local had to move to a new block. clean
+// receives the known-zero mark that applied to the range before the bump.
+u8* Arena::bump(usize size, u8** clean) {
+    if (cur + size > base + reserved_size) {
+        if (pages_committed == USIZE_MAX) {
+            AssertM(shared, "arena overran backing buffer");
+            refill(size);
+        } else if (chain_block_size) {
+            grow(size);
+        }
     }
 
+    u8* ret = cur;
+    if (clean) *clean = zero_mark;
+
+    cur += size;
+    if (cur > zero_mark) zero_mark = cur;
+#if ARENA_STATS
+    counters.bytes_pushed += size;
+    counters.peak_offset = max(counters.peak_offset, (usize)(cur - base));
+#endif
+
+    if (pages_committed == USIZE_MAX) return ret;
+
     usize total_commit_size = (usize)(cur - base);
-    usize total_pages_required = 1 + ((total_commit_size - 1) >> log_commit_page_size);
+    usize total_pages_required = 1 + ((total_commit_size - 1) >> log_commit_size);
 
     if (total_pages_required > pages_committed) {
-        AssertM(total_pages_required << log_commit_page_size <= reserved_size, "memory_reservation_commit would overrun the end of the reserved address space");
+        commit_pages(total_pages_required);
+    }
+
+    return ret;
+}
+
+void Arena::refill(usize size) {
+    usize block_size = max(refill_size, size);
+    base = shared->take_block(block_size);
+    cur = base;
+    reserved_size = block_size;
+    zero_mark = shared->zero_mark_for(base, block_size);
+}
+
+void Arena::grow(usize size) {
+    usize granule_size = (usize)1 << log_commit_size;
+    usize needed = (usize)(cur - base) + size - reserved_size;
+    usize extend_size = (max(needed, chain_block_size) + granule_size - 1) & ~(granule_size - 1);
+
+    if (mode != ARENA_PAGES_HUGE_EXPLICIT && mem_extend(base + reserved_size, extend_size)) {
+        reserved_size += extend_size;
+        return;
+    }
+
+    usize block_size = (max(size + sizeof(ArenaBlockHeader), chain_block_size) + granule_size - 1) & ~(granule_size - 1);
+    ArenaPageMode block_mode = mode;
+    u8* block = mem_reserve(block_size, &block_mode);
+
+    ArenaBlockHeader prev = {};
+    prev.chain = chain;
+    prev.base = base;
+    prev.cur = cur;
+    prev.zero_mark = zero_mark;
+    prev.pages_committed = pages_committed;
+    prev.reserved_size = reserved_size;
+
+    base = block;
+    zero_mark = block;
+    pages_committed = 0;
+    reserved_size = block_size;
+    chain = (ArenaBlockHeader*)block;
+
+    commit_pages(1);
+    *chain = prev;
+    cur = (u8*)(chain + 1);
+    zero_mark = cur;
+}
 
-        usize cur_size = pages_committed << log_commit_page_size;
-        usize add_pages = total_pages_required - pages_committed;
-        pages_committed = total_pages_required;
+// a mark at the very end of the current block can also be the start of an
+// earlier block that happened to be mapped right after it, so the end only
+// counts as part of the current block when no earlier block claims the mark.
+void Arena::pop_blocks_until(u8* mark) {
+    while (chain) {
+        u8* end = base + reserved_size;
+        if (mark >= (u8*)(chain + 1) && mark < end) break;
+        if (mark == end && !in_earlier_block(mark)) break;
+        pop_block();
+    }
+    AssertM(mark >= (chain ? (u8*)(chain + 1) : base) && mark <= base + reserved_size, "Arena::rewind mark is not in this arena");
+}
 
-        mem_commit(base + cur_size, add_pages << log_commit_page_size);
+bool Arena::in_earlier_block(u8* mark) {
+    for (ArenaBlockHeader* header = chain; header; header = header->chain) {
+        u8* start = header->chain ? (u8*)(header->chain + 1) : header->base;
+        if (mark >= start && mark < header->base + header->reserved_size) return true;
     }
+    return false;
 }
 
-u8* Arena::mem_reserve(usize size) {
-    return (u8*)mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+void Arena::pop_block() {
+    ArenaBlockHeader prev = *chain;
+    mem_release(base, reserved_size);
+    chain = prev.chain;
+    base = prev.base;
+    cur = prev.cur;
+    zero_mark = prev.zero_mark;
+    pages_committed = prev.pages_committed;
+    reserved_size = prev.reserved_size;
+}
+
+void Arena::commit_pages(usize total_pages_required) {
+    usize reserved_pages = reserved_size >> log_commit_size;
+    AssertM(total_pages_required <= reserved_pages, "memory_reservation_commit would overrun the end of the reserved address space");
+
+    usize target_pages = total_pages_required;
+    switch (commit_policy) {
+        case ARENA_COMMIT_CHUNKED:
+            target_pages = (target_pages + commit_chunk_pages - 1) / commit_chunk_pages * commit_chunk_pages;
+            break;
+        case ARENA_COMMIT_GEOMETRIC:
+            target_pages = max(target_pages, max(commit_chunk_pages, 2 * pages_committed));
+            break;
+        case ARENA_COMMIT_ALL:
+            target_pages = reserved_pages;
+            break;
+    }
+    target_pages = min(target_pages, reserved_pages);
+
+    if (target_pages <= pages_committed) return;
+
+    usize cur_size = pages_committed << log_commit_size;
+    usize add_pages = target_pages - pages_committed;
+    pages_committed = target_pages;
+
+    mem_commit(base + cur_size, add_pages << log_commit_size);
+
+#if ARENA_STATS
+    counters.commit_calls++;
+    counters.peak_bytes_committed = max(counters.peak_bytes_committed, pages_committed << log_commit_size);
+#endif
+}
+
+u8* Arena::mem_reserve(usize size, ArenaPageMode* page_mode) {
+#if !PLATFORM_APPLE
+    if (*page_mode == ARENA_PAGES_HUGE_EXPLICIT) {
+        // without MAP_NORESERVE the kernel reserves the huge pages up front, so an
+        // empty or undersized hugetlb pool fails here instead of SIGBUS-ing later.
+        void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) return (u8*)ptr;
+        *page_mode = ARENA_PAGES_HUGE_TRANSPARENT;
+    }
+    if (*page_mode == ARENA_PAGES_HUGE_TRANSPARENT && transparent_huge_pages_enabled) {
+        // over-reserve so the range can be trimmed to start on a huge page boundary.
+        usize huge_page_size = (usize)1 << ARENA_LOG_HUGE_PAGE_SIZE;
+        void* ptr = mmap(NULL, size + huge_page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        AssertM(ptr != MAP_FAILED, "Arena::mem_reserve mmap failed");
+
+        u8* start = (u8*)ptr;
+        u8* aligned = (u8*)(((usize)start + (huge_page_size - 1)) & ~(huge_page_size - 1));
+        if (aligned > start) mem_release(start, aligned - start);
+        if (aligned < start + huge_page_size) mem_release(aligned + size, start + huge_page_size - aligned);
+
+        if (madvise(aligned, size, MADV_HUGEPAGE) == 0) return aligned;
+        *page_mode = ARENA_PAGES_DEFAULT;
+        return aligned;
+    }
+#endif
+    *page_mode = ARENA_PAGES_DEFAULT;
+    void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    AssertM(ptr != MAP_FAILED, "Arena::mem_reserve mmap failed");
+    return (u8*)ptr;
+}
+
+// reserves [ptr, ptr + size) only if that exact range is still free. this is
+// opportunistic: mmap treats ptr as a hint and usually places mappings top-down,
+// so the range past an arena is often taken and callers must handle false.
+bool Arena::mem_extend(u8* ptr, usize size) {
+    void* result = mmap(ptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (result == MAP_FAILED) return false;
+    if (result != ptr) {
+        mem_release((u8*)result, size);
+        return false;
+    }
+#if !PLATFORM_APPLE
+    if (mode == ARENA_PAGES_HUGE_TRANSPARENT) {
+        madvise(ptr, size, MADV_HUGEPAGE);
+    }
+#endif
+    return true;
 }
 
 void Arena::mem_commit(u8* ptr, usize size) {
     int result = mprotect(ptr, size, PROT_READ | PROT_WRITE);
     AssertM(result != -1, "Arena::mem_commit mprotect failed");
+
+    if (prefault) {
+#if defined(MADV_POPULATE_WRITE)
+        if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0) return;
+#endif
+        // writing a zero into each page faults it in without changing its contents.
+        usize page_size = (usize)1 << log_commit_page_size;
+        for (usize offset = 0; offset < size; offset += page_size) {
+            *(volatile u8*)(ptr + offset) = 0;
+        }
+    }
+}
+
+// returns whether the pages were actually dropped. hugetlb mappings on older
+// kernels refuse MADV_DONTNEED, in which case they keep their contents.
+bool Arena::mem_decommit(u8* ptr, usize size) {
+    bool dropped;
+#if PLATFORM_APPLE
+    if (!decommit_lazy) {
+        // mapping fresh pages over the range drops the old ones and guarantees
+        // zero-fill when they're committed again.
+        void* result = mmap(ptr, size, PROT_NONE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        AssertM(result != MAP_FAILED, "Arena::mem_decommit mmap failed");
+        return true;
+    }
+    dropped = madvise(ptr, size, MADV_FREE) == 0;
+#else
+    // MADV_FREE needs linux 4.5, so fall back to dropping the pages eagerly.
+    dropped = decommit_lazy && madvise(ptr, size, MADV_FREE) == 0;
+    if (!dropped) {
+        dropped = madvise(ptr, size, MADV_DONTNEED) == 0;
+    }
+#endif
+    int result = mprotect(ptr, size, PROT_NONE);
+    AssertM(result != -1, "Arena::mem_decommit mprotect failed");
+    return dropped;
 }
 
 void Arena::mem_release(u8* ptr, usize size) {
@@ -156,14 +514,73 @@ void Arena::mem_release(u8* ptr, usize size) {
 
 // -----------------------------------------------------------------------------
 
+void SharedArena::create(usize reserve_size, ArenaPageMode page_mode) {
+    backing.create(reserve_size, page_mode);
+    // committing is per-process bookkeeping, so do it once instead of racing
+    // threads through mprotect. pages still only become resident when touched.
+    backing.set_commit_policy(ARENA_COMMIT_ALL);
+    base = backing.cur;
+    dirty_size = 0;
+    *offset = 0;
+}
+
+void SharedArena::destroy() {
+    backing.destroy();
+    ZeroStruct(this);
+}
+
+void SharedArena::clear() {
+    dirty_size = max(dirty_size, (usize)*offset);
+    *offset = 0;
+}
+
+Arena SharedArena::make_local(usize block_size) {
+    Arena ret = {};
+    ret.pages_committed = USIZE_MAX;
+    ret.shared = this;
+    ret.refill_size = block_size;
+    ret.refill(0);
+    return ret;
+}
+
+forall(T) T* SharedArena::push() {
+    u8* ret = bump(sizeof(T), alignof(T));
+    if (ret < base + dirty_size) memset(ret, 0, sizeof(T));
+    return (T*)ret;
+}
+
+forall(T) Slice<T> SharedArena::push_many(usize count) {
+    if (count == 0) return Slice<T>{};
+    usize size = sizeof(T) * count;
+    u8* ret = bump(size, alignof(T));
+    u8* clean = base + dirty_size;
+    if (ret < clean) memset(ret, 0, min(size, (usize)(clean - ret)));
+    return Slice<T>{(T*)ret, count};
+}
+
+// over-allocates by the alignment so the add can stay a single fetch_add.
+u8* SharedArena::bump(usize size, usize align) {
+    usize padded = size + align - 1;
+    usize start = ::std::atomic_fetch_add_explicit(offset.ptr(), padded, ::std::memory_order_relaxed);
+    AssertM(start + padded <= backing.reserved_size, "shared arena is full");
+    return (u8*)(((usize)(base + start) + (align - 1)) & ~(align - 1));
+}
+
+// -----------------------------------------------------------------------------
+
 void arena_bind_global_scratch(Arena* scratch0, Arena* scratch1) {
     g_arena_scratch[0] = scratch0;
     g_arena_scratch[1] = scratch1;
 }
 
 ScratchArena::ScratchArena() {
+    if (!g_arena_scratch[0]) Arena::thread_init_scratch();
     arena = g_arena_scratch[0];
     arena_mark = arena->cur;
+#if ARENA_STATS
+    arena->counters.scratch_depth++;
+    arena->counters.peak_scratch_depth = max(arena->counters.peak_scratch_depth, arena->counters.scratch_depth);
+#endif
 }
 
 ScratchArena::ScratchArena(Arena* conflict) {
@@ -176,10 +593,15 @@ ScratchArena::ScratchArena(Slice<Arena*> conflicts) {
 }
 
 ScratchArena::~ScratchArena() {
-    arena->cur = arena_mark;
+#if ARENA_STATS
+    arena->counters.scratch_depth--;
+#endif
+    arena->rewind(arena_mark);
 }
 
 void ScratchArena::init(Slice<Arena*> conflicts) {
+    if (!g_arena_scratch[0]) Arena::thread_init_scratch();
+
     bool matched[2] = {};
     for (u32 i = 0; i < conflicts.count; ++i) {
         if (g_arena_scratch[0] == conflicts.elems[i]) {
@@ -193,11 +615,251 @@ void ScratchArena::init(Slice<Arena*> conflicts) {
 
     arena = g_arena_scratch[matched[0] ? 1 : 0];
     arena_mark = arena->cur;
+#if ARENA_STATS
+    arena->counters.scratch_depth++;
+    arena->counters.peak_scratch_depth = max(arena->counters.peak_scratch_depth, arena->counters.scratch_depth);
+#endif
 
     return;
 err:
     Panic("both scratch arenas were passed as conflicts to ScratchArena::init");
 }
 
+// -----------------------------------------------------------------------------
+
+void print_value(Arena* out, ArenaStats value) {
+    char buffer[512];
+    snprintf(
+        buffer, sizeof(buffer),
+        "reserved=%zu committed=%zu peak_committed=%zu peak_offset=%zu pushed=%llu commits=%llu decommits=%llu scratch_depth=%u peak_scratch_depth=%u",
+        value.bytes_reserved, value.bytes_committed, value.peak_bytes_committed, value.peak_offset,
+        value.bytes_pushed, value.commit_calls, value.decommit_calls, value.scratch_depth, value.peak_scratch_depth
+    );
+    print_value(out, (cchar*)buffer);
+}
+
+void arena_print_scratch_stats(Arena* out) {
+    for (u32 i = 0; i < 2; ++i) {
+        if (!g_arena_scratch[i]) continue;
+        print_value(out, i == 0 ? "scratch[0] " : "scratch[1] ");
+        print_value(out, g_arena_scratch[i]->stats());
+        print_value(out, '\n');
+    }
+}
+
+// -----------------------------------------------------------------------------
+#if TEST
+void test_arena() {
+    Arena arena = {};
+
+    // huge page modes fall back to a lower mode when the kernel can't back
+    // them, and whatever mode takes effect has to work across a 2mb granule.
+    ArenaPageMode modes[3] = {ARENA_PAGES_DEFAULT, ARENA_PAGES_HUGE_TRANSPARENT, ARENA_PAGES_HUGE_EXPLICIT};
+    for (u32 i = 0; i < 3; ++i) {
+        arena.create(8_mb, modes[i]);
+        AssertM(arena.page_mode() <= modes[i], "page mode %u came out as %u", modes[i], arena.page_mode());
+
+        Slice<u8> bytes = arena.push_many<u8>(3_mb);
+        memset(bytes.elems, 0xab, bytes.count);
+        Assert(bytes.elems[2_mb - 1] == 0xab && bytes.elems[2_mb] == 0xab);
+
+        arena.destroy();
+    }
+
+    arena.create(1_gb);
+
+    // each geometric commit at least doubles what's committed, so streaming
+    // 100mb through in 1mb pushes ends up at the next power of 2.
+    arena.set_commit_policy(ARENA_COMMIT_GEOMETRIC);
+    for (u32 i = 0; i < 100; ++i) {
+        arena.push_many_uninit<u8>(1_mb);
+    }
+    usize committed = arena.stats().bytes_committed;
+    AssertM(committed == 128_mb, "committed %zu bytes for 100mb of pushes", committed);
+
+    arena.destroy();
+
+    // trimming after a rewind gives the pages back, and whatever gets pushed
+    // over them again reads as zero, whether they were decommitted outright or
+    // lazily freed and maybe handed back with their old contents.
+    for (u32 lazy = 0; lazy < 2; ++lazy) {
+        arena.create(64_mb);
+        arena.set_decommit_policy(4_mb, 0, lazy);
+
+        u8* start = arena.cur;
+        Slice<u8> dirty = arena.push_many<u8>(8_mb);
+        memset(dirty.elems, 0xff, dirty.count);
+        Assert(arena.stats().bytes_committed >= 8_mb);
+
+        Assert(arena.zero_mark == arena.cur);
+        arena.rewind(start);
+        Assert(arena.stats().bytes_committed == 0);
+
+        // only memory that was really decommitted is known to be zero again.
+        Assert(arena.zero_mark == (lazy ? start + dirty.count : arena.base));
+
+        Slice<u8> reused = arena.push_many<u8>(8_mb);
+        for (usize i = 0; i < reused.count; i += 4096) {
+            AssertM(reused.elems[i] == 0, "byte %zu came back dirty after a trim", i);
+        }
+
+        arena.destroy();
+    }
+
+    // stats count every push and syscall, and the printed form is what ends up
+    // in logs, so check both against a known sequence.
+    arena.create(64_mb);
+    arena.set_commit_policy(ARENA_COMMIT_CHUNKED, 1_mb);
+    {
+        u8* start = arena.cur;
+        arena.push_many<u8>(3_mb);
+        arena.rewind(start);
+        arena.trim();
+
+        ArenaStats stats = arena.stats();
+        Assert(stats.bytes_reserved == 64_mb && stats.bytes_committed == 0);
+#if ARENA_STATS
+        Assert(stats.bytes_pushed == 3_mb && stats.peak_offset == 3_mb);
+        AssertM(stats.commit_calls == 1 && stats.decommit_calls == 1, "%llu commits, %llu decommits", stats.commit_calls, stats.decommit_calls);
+        Assert(stats.peak_bytes_committed == 3_mb);
+#endif
+
+        ScratchArena scratch{};
+        char* text = (char*)scratch.arena->cur;
+        print_value(scratch.arena, stats);
+        arena_print_scratch_stats(scratch.arena);
+        print_value(scratch.arena, '\0');
+        Assert(strstr(text, "reserved=67108864 committed=0 "));
+        Assert(strstr(text, "scratch[0] reserved="));
+#if ARENA_STATS
+        Assert(strstr(text, "peak_committed=3145728 peak_offset=3145728 pushed=3145728 commits=1 decommits=1"));
+        Assert(strstr(text, "scratch_depth=1 peak_scratch_depth=1\n"));
+#endif
+    }
+    arena.destroy();
+}
+
+#define THREAD_COUNT 16
+#define NUM_PUSHES 4096
+
+struct TestSharedArenaThread {
+    SharedArena* shared;
+    u64 id;
+    Slice<u64*> items;
+};
+
+void* test_shared_arena_thread(void* arg) {
+    TestSharedArenaThread* ctx = (TestSharedArenaThread*)arg;
+    Arena local = ctx->shared->make_local(4_kb);
+    for (u64 i = 0; i < NUM_PUSHES; ++i) {
+        u64* item = i % 2 ? local.push<u64>() : ctx->shared->push<u64>();
+        Assert(*item == 0);
+        *item = ctx->id * NUM_PUSHES + i;
+        ctx->items[i] = item;
+    }
+    return nullptr;
+}
+
+void test_shared_arena() {
+    SharedArena shared = {};
+    shared.create(64_mb);
+
+    for (int round = 0; round < 2; ++round) {
+        ScratchArena scratch{};
+        TestSharedArenaThread ctxs[THREAD_COUNT];
+        pthread_t threads[THREAD_COUNT];
+
+        for (u64 i = 0; i < THREAD_COUNT; ++i) {
+            ctxs[i] = {&shared, i, scratch.arena->push_many<u64*>(NUM_PUSHES)};
+            pthread_create(&threads[i], NULL, test_shared_arena_thread, &ctxs[i]);
+        }
+        for (u64 i = 0; i < THREAD_COUNT; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        for (u64 i = 0; i < THREAD_COUNT; ++i) {
+            for (u64 j = 0; j < NUM_PUSHES; ++j) {
+                AssertM(*ctxs[i].items[j] == i * NUM_PUSHES + j, "shared arena handed out overlapping memory");
+            }
+        }
+
+        shared.clear();
+    }
+
+    shared.destroy();
+}
+
+#undef THREAD_COUNT
+#undef NUM_PUSHES
+
+void test_chained_arena() {
+    Arena arena = {};
+    arena.create(16_kb);
+    arena.enable_chaining();
+
+    u8* start = arena.cur;
+    u64* items[4096];
+    for (u64 round = 0; round < 3; ++round) {
+        for (u64 i = 0; i < 4096; ++i) {
+            items[i] = arena.push<u64>();
+            Assert(*items[i] == 0);
+            *items[i] = i;
+        }
+
+        u8* mark = arena.cur;
+        Slice<u8> big = arena.push_many<u8>(256_kb);
+        memset(big.elems, 0xff, big.count);
+        for (u64 i = 0; i < 4096; ++i) {
+            Assert(*items[i] == i);
+        }
+
+        arena.rewind(mark);
+        Assert(arena.cur == mark);
+        Slice<u8> reused = arena.push_many<u8>(64_kb);
+        for (usize i = 0; i < reused.count; ++i) {
+            Assert(reused.elems[i] == 0);
+        }
+
+        arena.rewind(start);
+    }
+
+    arena.push_many<u8>(1_mb);
+    arena.clear();
+    Assert(arena.cur == start);
+    arena.destroy();
+}
+
+void* test_thread_scratch_thread(void* arg) {
+    usize reserve_size = *(usize*)arg;
+    if (reserve_size) Arena::thread_init_scratch(reserve_size);
+
+    ScratchArena scratch{};
+    ScratchArena inner{scratch.arena};
+    Assert(scratch.arena != inner.arena);
+
+    // scratch arenas don't chain, so this has to fit the small reservation.
+    u8* start = scratch.arena->cur;
+    Slice<u8> bytes = scratch.arena->push_many<u8>(32_kb);
+    Assert(bytes.elems == start && scratch.arena->cur == start + 32_kb);
+    memset(bytes.elems, 0xff, bytes.count);
+    *inner.arena->push<u64>() = 1;
+
+    return scratch.arena;
+}
+
+void test_thread_scratch() {
+    ScratchArena main_scratch{};
+
+    usize sizes[2] = {0, 64_kb};
+    pthread_t threads[2];
+    for (u32 i = 0; i < 2; ++i) {
+        pthread_create(&threads[i], NULL, test_thread_scratch_thread, &sizes[i]);
+    }
+    for (u32 i = 0; i < 2; ++i) {
+        void* thread_arena;
+        pthread_join(threads[i], &thread_arena);
+        Assert(thread_arena && thread_arena != main_scratch.arena);
+    }
+}
+#endif
 // -----------------------------------------------------------------------------
 }  // namespace a
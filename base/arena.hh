@@ -3,10 +3,91 @@
 namespace a {
 // -----------------------------------------------------------------------------
 
+// Counting pushes, peaks and syscalls costs a few adds per push, so it's off
+// unless ARENA_STATS is defined to 1. Committed and reserved sizes are always
+// reported since they're known anyway.
+//
+// Offsets and committed sizes describe the block the arena is currently
+// pushing into: a chained arena or a SharedArena local that moves to a fresh
+// block starts measuring again from that block's base, while the push and
+// syscall counts keep accumulating across blocks.
+#ifndef ARENA_STATS
+#define ARENA_STATS 0
+#endif
+
+struct ArenaStats {
+    usize bytes_reserved;
+    usize bytes_committed;
+    usize peak_bytes_committed;
+    usize peak_offset;  // furthest the cursor has ever been from the base
+    u64 bytes_pushed;
+    u64 commit_calls;
+    u64 decommit_calls;
+    u32 scratch_depth;
+    u32 peak_scratch_depth;
+};
+
+void print_value(Arena* out, ArenaStats value);
+
+// What kind of pages back an arena's reservation. Huge page modes fall back to
+// the next mode down when the kernel can't provide them, so check page_mode()
+// after create() to see which one actually took effect.
+enum ArenaPageMode : u8 {
+    ARENA_PAGES_DEFAULT,
+    ARENA_PAGES_HUGE_TRANSPARENT,  // 2mb aligned reservation + madvise(MADV_HUGEPAGE)
+    ARENA_PAGES_HUGE_EXPLICIT,     // MAP_HUGETLB, needs pages in the hugetlb pool
+};
+
+// How far ahead of the cursor an arena commits when it runs out of committed
+// memory. Fewer, larger commits mean fewer mprotect calls on hot push paths.
+enum ArenaCommitPolicy : u8 {
+    ARENA_COMMIT_CHUNKED,    // round each commit up to a multiple of the chunk size
+    ARENA_COMMIT_GEOMETRIC,  // each commit at least doubles the committed size
+    ARENA_COMMIT_ALL,        // commit the whole reservation up front
+};
+
+class SharedArena;
+
+// blocks handed out by a SharedArena and the data start of chained blocks are
+// aligned to this, which covers cache line aligned types on every platform.
+konst usize ARENA_BLOCK_ALIGN = 128;
+
+// saved state of the previous block, stored at the start of each chained block.
+struct alignas(ARENA_BLOCK_ALIGN) ArenaBlockHeader {
+    ArenaBlockHeader* chain;
+    u8* base;
+    u8* cur;
+    u8* zero_mark;
+    usize pages_committed;
+    usize reserved_size;
+};
+
 class Arena {
     u8* base;
+    u8* zero_mark;  // committed memory from here on has never been written to
     usize pages_committed;
     usize reserved_size;
+    usize commit_chunk_pages;
+    usize decommit_high_water_pages;
+    usize decommit_low_water_pages;
+    SharedArena* shared;
+    usize refill_size;
+    ArenaBlockHeader* chain;  // header of the current block when it was chained on, at base
+    usize chain_block_size;
+    u32 log_commit_size;
+    ArenaPageMode mode;
+    ArenaCommitPolicy commit_policy;
+    bool prefault;
+    bool decommit_lazy;
+#if ARENA_STATS
+    ArenaStats counters;
+#endif
+
+    friend struct ScratchArena;
+    friend class SharedArena;
+#if TEST
+    friend void test_arena();
+#endif
 
   public:
     u8* cur;
@@ -15,11 +96,54 @@ class Arena {
     func void global_init();
     func void thread_init(Arena* scratch0, Arena* scratch1);
 
+    // threads that never call thread_init get their scratch arenas created on
+    // first use instead, reserving the default size each. they don't chain,
+    // since callers like StrBuilder treat what they push as one contiguous run.
+    // they're destroyed when the thread exits. worker threads can call
+    // thread_init_scratch up front to pick their own size.
+    func void set_default_scratch_size(usize reserve_size);
+    func void thread_init_scratch(usize reserve_size = 0);
+
     func Arena make_with_buffer(u8* bytes, usize count);
-    void create(usize reserve_size = 0);
+    void create(usize reserve_size = 0, ArenaPageMode page_mode = ARENA_PAGES_DEFAULT);
     void destroy();
 
-    void clear() { cur = base; }
+    ArenaPageMode page_mode() { return mode; }
+    ArenaStats stats();
+
+    // chunk_size of 0 means one commit granule. with prefault set, newly committed
+    // memory is faulted in immediately instead of on first touch.
+    void set_commit_policy(ArenaCommitPolicy policy, usize chunk_size = 0, bool prefault = false);
+
+    // once more than high_water bytes are committed, rewinding the arena gives
+    // memory back to the os down to max(cursor, low_water). lazy uses MADV_FREE,
+    // which is cheaper but lets the kernel reclaim the pages only under pressure.
+    void set_decommit_policy(usize high_water, usize low_water, bool lazy = false);
+
+    // decommits everything past max(cursor, keep_size).
+    void trim(usize keep_size = 0);
+
+    // lets the arena outgrow its reservation by linking on a new block of at
+    // least block_size (0 means the size of the first reservation). extending
+    // the current reservation in place is tried first, but that's opportunistic:
+    // with the kernel placing mappings top-down it rarely works on linux, so
+    // expect new blocks.
+    // rewinding to a mark from an earlier block releases the newer ones. a single
+    // push is always contiguous, but a run of pushes only is if no new block was
+    // linked on in between.
+    void enable_chaining(usize block_size = 0);
+
+    void rewind(u8* mark) {
+        DebugAssertM(!shared || (mark >= base && mark <= base + reserved_size), "SharedArena locals can't rewind to a mark from an earlier block");
+        if (chain && (mark < (u8*)(chain + 1) || mark >= base + reserved_size)) {
+            pop_blocks_until(mark);
+        }
+        cur = mark;
+        if (decommit_high_water_pages && pages_committed > decommit_high_water_pages) {
+            trim(decommit_low_water_pages << log_commit_size);
+        }
+    }
+    void clear();
 
     void max_align();
     forall(T) void align();
@@ -29,17 +153,72 @@ class Arena {
     forall(T) Slice<T> push_many_unaligned(usize count);
     void push_bytes(void* start, usize size);
 
+    // the _uninit variants skip zeroing for callers that overwrite everything
+    // they push. the zeroing variants already skip it for never-touched memory.
+    forall(T) T* push_uninit();
+    forall(T) T* push_unaligned_uninit();
+    forall(T) Slice<T> push_many_uninit(usize count);
+
   private:
     global u32 log_reserve_page_size;
     global u32 log_commit_page_size;
+    global bool transparent_huge_pages_enabled;
 
-    void bump(usize size);
+    u8* bump(usize size, u8** clean = nullptr);
+    u8* bump_zeroed(usize size);
+    void refill(usize size);
+    void grow(usize size);
+    void pop_blocks_until(u8* mark);
+    bool in_earlier_block(u8* mark);
+    void pop_block();
+    void commit_pages(usize total_pages_required);
 
-    u8* mem_reserve(usize size);
+    u8* mem_reserve(usize size, ArenaPageMode* page_mode);
+    bool mem_extend(u8* ptr, usize size);
     void mem_commit(u8* ptr, usize size);
+    bool mem_decommit(u8* ptr, usize size);
     void mem_release(u8* ptr, usize size);
 };
 
+// Arena that many threads can allocate from at once. Each thread allocates
+// through its own local Arena from make_local(), which carves blocks off the
+// shared reservation with a single atomic add and otherwise pushes exactly like
+// a buffer-backed Arena, so anything taking an Arena* (Channel::make,
+// HashArray_::make, ...) can place its memory in the shared range:
+//
+//     Arena local = shared->make_local();
+//     Channel<Msg> chan = Channel<Msg>::make(&local, 1024);
+//
+// Locals can't rewind to marks taken before they moved on to a new block, and
+// consecutive pushes are only contiguous within a block. Everything lives until
+// the SharedArena is cleared or destroyed.
+class SharedArena {
+    Arena backing;
+    u8* base;
+    usize dirty_size;
+    AtomicVal<usize> offset;
+
+  public:
+    konst usize DEFAULT_BLOCK_SIZE = 64_kb;
+
+    void create(usize reserve_size, ArenaPageMode page_mode = ARENA_PAGES_DEFAULT);
+    void destroy();
+    // must not race with any pushes or locals still in use.
+    void clear();
+
+    Arena make_local(usize block_size = DEFAULT_BLOCK_SIZE);
+
+    forall(T) T* push();
+    forall(T) Slice<T> push_many(usize count);
+
+  private:
+    u8* bump(usize size, usize align);
+    u8* take_block(usize size) { return bump(size, ARENA_BLOCK_ALIGN); }
+    u8* zero_mark_for(u8* block, usize size) { return max(block, min(block + size, base + dirty_size)); }
+
+    friend class Arena;
+};
+
 struct ScratchArena : MagicScopeStruct {
     u8* arena_mark;
     Arena* arena;
@@ -53,5 +232,17 @@ struct ScratchArena : MagicScopeStruct {
     void init(Slice<Arena*> conflicts);
 };
 
+// prints the stats of both of the calling thread's scratch arenas.
+void arena_print_scratch_stats(Arena* out);
+
+// -----------------------------------------------------------------------------
+
+#if TEST
+void test_arena();
+void test_shared_arena();
+void test_chained_arena();
+void test_thread_scratch();
+#endif
+
 // -----------------------------------------------------------------------------
 }  // namespace a
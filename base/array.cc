@@ -57,6 +57,7 @@ forall(T) void print_value(Arena* out, Slice<T>& slice) {
 forall(T) This This::make(Arena* arena, usize capacity) {
     return {
         .elems = arena->push_many<T>(capacity).elems,
+        .count = 0,
         .capacity = capacity,
     };
 }
@@ -64,6 +65,7 @@ forall(T) This This::make(Arena* arena, usize capacity) {
 forall(T) This This::from_ptr(T* ptr, usize capacity) {
     return {
         .elems = ptr,
+        .count = 0,
         .capacity = capacity,
     };
 }
@@ -87,6 +89,32 @@ forall(T) T* This::pop() {
     return &elems[--count];
 }
 
+forall(T) T* This::push(Arena* arena) {
+    if (count == capacity) reserve(arena, max((usize)4, 2 * capacity));
+    return ZeroStruct(&elems[count++]);
+}
+
+// if the vec is still the last thing pushed onto the arena it's extended in place,
+// otherwise it's copied to the top of the arena and the old storage is left behind.
+forall(T) void This::reserve(Arena* arena, usize min_capacity) {
+    if (min_capacity <= capacity) return;
+
+    if (elems && (u8*)(elems + capacity) == arena->cur) {
+        // a chained arena can put the extension in a fresh block, in which case
+        // it goes to waste and the copy below lands after it.
+        T* extension = arena->push_many_uninit<T>(min_capacity - capacity).elems;
+        if (extension == elems + capacity) {
+            capacity = min_capacity;
+            return;
+        }
+    }
+
+    T* new_elems = arena->push_many_uninit<T>(min_capacity).elems;
+    MemCopy(new_elems, elems, count * sizeof(T));
+    elems = new_elems;
+    capacity = min_capacity;
+}
+
 forall(T) void print_value(Arena* out, This& vec) {
     Slice<T> slice = vec.slice();
     print_value(out, slice);
@@ -194,7 +222,7 @@ forall(T) void This::remove(T* elem) {
 }
 
 forall(T) Slice<T> This::copy_into_array(Arena* arena) {
-    Slice<T> ret = arena->push_many<T>(count);
+    Slice<T> ret = arena->push_many_uninit<T>(count);
     foreach_idx(i, it, iter()) {
         ret.elems[i] = *it.item;
     }
@@ -225,4 +253,32 @@ forall(T) void This::Iter::next() {
 
 #undef This
 // -----------------------------------------------------------------------------
+#if TEST
+
+void test_vec() {
+    ScratchArena scratch{};
+
+    // nothing else pushed in between, so the vec keeps growing in place.
+    Vec<u64> in_place = Vec<u64>::make(scratch.arena, 4);
+    u64* first_elems = in_place.elems;
+    for (u64 i = 0; i < 1000; ++i) {
+        *in_place.push(scratch.arena) = i;
+    }
+    Assert(in_place.elems == first_elems && in_place.count == 1000 && in_place.capacity >= 1000);
+
+    // another allocation right after the vec forces every grow to copy.
+    Vec<u64> copied = Vec<u64>::make(scratch.arena, 4);
+    for (u64 i = 0; i < 1000; ++i) {
+        *copied.push(scratch.arena) = i;
+        scratch.arena->push<u8>();
+    }
+    Assert(copied.count == 1000 && copied.capacity >= 1000);
+
+    for (u64 i = 0; i < 1000; ++i) {
+        AssertM(in_place[i] == i && copied[i] == i, "element %llu lost while growing", i);
+    }
+}
+
+#endif
+// -----------------------------------------------------------------------------
 }  // namespace a
@@ -70,6 +70,10 @@ forall(T) struct Vec {
     Slice<T> slice();
     T* push();
     T* pop();
+
+    // grows the vec in arena when it's full, which must be the arena it was made in.
+    T* push(Arena* arena);
+    void reserve(Arena* arena, usize min_capacity);
 };
 
 forall(T) void print_value(Arena* out, Slice<T>& slice);
@@ -155,5 +159,10 @@ forall(T) class List {
     Iter iter() { return Iter::make(this); };
 };
 
+// -----------------------------------------------------------------------------
+
+#if TEST
+void test_vec();
+#endif
 // -----------------------------------------------------------------------------
 }  // namespace a
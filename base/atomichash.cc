@@ -0,0 +1,174 @@
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+#define Template template <typename K, typename V, bool PREHASHED>
+#define This AtomicHashArray_<K, V, PREHASHED>
+
+Template This This::make(Arena* arena, u64 capacity, u64 max_elems) {
+    AtomicVal<u64>* hashes = arena->push_many<AtomicVal<u64>>(capacity).elems;
+    K* keys = arena->push_many<K>(capacity).elems;
+    V* values = arena->push_many<V>(capacity).elems;
+    V* value_stub = arena->push<V>();
+
+    This map = {};
+
+    map.capacity = capacity;
+    map.max_elems = max_elems;
+
+    map.hashes = hashes;
+    map.keys = keys;
+    map.values = values;
+    map.value_stub = value_stub;
+
+    return map;
+}
+
+Template This This::make_with_cap(Arena* arena, u64 capacity) {
+    capacity = next_power_of_2(capacity);
+    u64 max_elems = capacity * LOAD_FACTOR_PERCENT / 100;
+    return This::make(arena, capacity, max_elems);
+}
+
+Template This This::make_with_elems(Arena* arena, u64 max_elems) {
+    u64 capacity = next_power_of_2(max_elems * 100 / LOAD_FACTOR_PERCENT);
+    return This::make(arena, capacity, max_elems);
+}
+
+// 0 and 1 mark empty and busy slots, so real hashes get moved out of the way.
+Template u64 This::hash_key(K* key) {
+    u64 hash;
+    if constexpr (PREHASHED) {
+        hash = key->hash;
+    } else {
+        hash = hash64_bytes((u8*)key, sizeof(K));
+    }
+    if (hash < 2) hash += 2;
+    return hash;
+}
+
+Template bool This::keys_equal(K* a, K* b) {
+    if constexpr (requires { a->eq(b); }) {
+        return a->eq(b);
+    } else {
+        return memcmp(a, b, sizeof(K)) == 0;
+    }
+}
+
+// Returns the value already stored for key if there is one, otherwise a copy
+// of *value that's now stored for it.
+Template V* This::insert(K* key, V* value) {
+    u64 hash = hash_key(key);
+    u64 mask = capacity - 1;
+
+    for (u64 probe = 0, i = hash & mask; probe < capacity; ++probe, i = (i + 1) & mask) {
+        u64 stored_hash = ::std::atomic_load_explicit(hashes[i].ptr(), ::std::memory_order_acquire);
+
+        if (stored_hash == HASH_EMPTY) {
+            if (::std::atomic_compare_exchange_strong_explicit(hashes[i].ptr(), &stored_hash, HASH_BUSY, ::std::memory_order_acquire, ::std::memory_order_acquire)) {
+                u64 prev_count = ::std::atomic_fetch_add_explicit(elem_count.ptr(), 1, ::std::memory_order_relaxed);
+                AssertM(prev_count < max_elems, "hasharray is full");
+
+                keys[i] = *key;
+                values[i] = *value;
+                ::std::atomic_store_explicit(hashes[i].ptr(), hash, ::std::memory_order_release);
+                return &values[i];
+            }
+        }
+
+        // someone else is filling this slot, possibly with this same key.
+        while (stored_hash == HASH_BUSY) {
+            cpu_relax();
+            stored_hash = ::std::atomic_load_explicit(hashes[i].ptr(), ::std::memory_order_acquire);
+        }
+
+        if (stored_hash == hash && keys_equal(&keys[i], key)) return &values[i];
+    }
+
+    Panic("hasharray is full");
+}
+
+Template V* This::maybe_get(K* key) {
+    u64 hash = hash_key(key);
+    u64 mask = capacity - 1;
+
+    for (u64 probe = 0, i = hash & mask; probe < capacity; ++probe, i = (i + 1) & mask) {
+        u64 stored_hash = ::std::atomic_load_explicit(hashes[i].ptr(), ::std::memory_order_acquire);
+        if (stored_hash == HASH_EMPTY) return nullptr;
+        if (stored_hash == hash && keys_equal(&keys[i], key)) return &values[i];
+    }
+
+    return nullptr;
+}
+
+Template V* This::get(K* key) {
+    V* value = maybe_get(key);
+    return value ? value : value_stub;
+}
+
+Template u64 This::count() {
+    return ::std::atomic_load_explicit(elem_count.ptr(), ::std::memory_order_relaxed);
+}
+
+#undef Template
+#undef This
+// -----------------------------------------------------------------------------
+#if TEST
+#define THREAD_COUNT 8
+#define NUM_KEYS 20000
+
+struct TestAtomicHashArgs {
+    AtomicHashArray<u64, u64>* map;
+    u64 thread_idx;
+};
+
+// every thread inserts every key, starting from a different place, while also
+// looking up keys other threads should be busy inserting.
+void* test_atomichash_thread(void* arg) {
+    TestAtomicHashArgs* args = (TestAtomicHashArgs*)arg;
+    AtomicHashArray<u64, u64>* map = args->map;
+
+    for (u64 n = 0; n < NUM_KEYS; ++n) {
+        u64 key = (n + args->thread_idx * NUM_KEYS / THREAD_COUNT) % NUM_KEYS;
+        u64 value = key * 3;
+        u64* stored = map->insert(&key, &value);
+        AssertM(*stored == key * 3, "wrong value for key %llu", key);
+
+        u64 other = (key * 7919) % NUM_KEYS;
+        u64* seen = map->maybe_get(&other);
+        AssertM(!seen || *seen == other * 3, "read a half inserted value for key %llu", other);
+
+        if (n % 64 == 0) sched_yield();
+    }
+
+    return nullptr;
+}
+
+void test_atomichash() {
+    ScratchArena scratch{};
+
+    AtomicHashArray<u64, u64> map = AtomicHashArray<u64, u64>::make_with_elems(scratch.arena, NUM_KEYS);
+
+    pthread_t threads[THREAD_COUNT];
+    TestAtomicHashArgs args[THREAD_COUNT];
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        args[i] = {&map, i};
+        pthread_create(&threads[i], NULL, test_atomichash_thread, &args[i]);
+    }
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    Assert(map.count() == NUM_KEYS);
+    for (u64 key = 0; key < NUM_KEYS; ++key) {
+        u64* value = map.maybe_get(&key);
+        AssertM(value && *value == key * 3, "key %llu missing after insert", key);
+    }
+    u64 missing = NUM_KEYS;
+    Assert(!map.maybe_get(&missing) && *map.get(&missing) == 0);
+}
+
+#undef THREAD_COUNT
+#undef NUM_KEYS
+#endif
+// -----------------------------------------------------------------------------
+}  // namespace a
@@ -0,0 +1,59 @@
+#pragma once
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+#define Template template <typename K, typename V, bool PREHASHED>
+
+// Fixed size open addressing map that any number of threads can insert into
+// and read from at once, for sharing lookup tables between workers. Hashing
+// and key comparison work like HashArray_. Inserting claims an empty slot by
+// swapping its hash from 0 to 1, fills in the key and value, then publishes
+// the real hash with a release store. Lookups never wait: they skip slots that
+// are mid-insert, so an insert only becomes visible once it's published.
+// Inserters do wait on those slots, since they might be inserting the same key.
+// Nothing is ever removed, and once inserted a value doesn't move, so readers
+// can hold onto the pointers they get back.
+
+Template class AtomicHashArray_ {
+    konst u32 LOAD_FACTOR_PERCENT = 70;
+    konst u64 HASH_EMPTY = 0;
+    konst u64 HASH_BUSY = 1;
+
+    AtomicVal<u64>* hashes;
+    K* keys;
+    V* values;
+    V* value_stub;
+    AtomicVal<u64> elem_count;
+
+  public:
+    u64 capacity;
+    u64 max_elems;
+
+    func AtomicHashArray_ make_with_cap(Arena* arena, u64 capacity);
+    func AtomicHashArray_ make_with_elems(Arena* arena, u64 max_elems);
+
+    V* insert(K* key, V* value);
+    V* maybe_get(K* key);
+    V* get(K* key);
+    u64 count();
+
+  private:
+    func AtomicHashArray_ make(Arena* arena, u64 capacity, u64 max_elems);
+    func u64 hash_key(K* key);
+    func bool keys_equal(K* a, K* b);
+};
+
+template <typename K, typename V>
+using AtomicHashArray = AtomicHashArray_<K, V, false>;
+
+template <typename K, typename V>
+using AtomicPreHashArray = AtomicHashArray_<K, V, true>;
+
+#undef Template
+// -----------------------------------------------------------------------------
+
+#if TEST
+void test_atomichash();
+#endif
+// -----------------------------------------------------------------------------
+}  // namespace a
@@ -47,8 +47,8 @@ bool bin_deserialize(Arena* arena, void* ctx, u8* end, u8** read, bool* val) {
 
 void bin_serialize(Arena* out, Str* val) {
     u32 count = val->count;
-    MemCopy(out->push_unaligned<u32>(), &count, sizeof(u32));
-    char* buffer = out->push_many<char>(val->count).elems;
+    MemCopy(out->push_unaligned_uninit<u32>(), &count, sizeof(u32));
+    char* buffer = out->push_many_uninit<char>(val->count).elems;
     MemCopy(buffer, val->elems, val->count);
 }
 
@@ -56,7 +56,7 @@ bool bin_deserialize(Arena* arena, void* ctx, u8* end, u8** read, Str* val) {
     u32 count = 0;
     if (!bin_deserialize(arena, ctx, end, read, &count)) return false;
     if (*read + count > end) return false;
-    char* buffer = arena->push_many<char>(count).elems;
+    char* buffer = arena->push_many_uninit<char>(count).elems;
     MemCopy(buffer, *read, count);
     *read += count;
     *val = Str{buffer, count};
@@ -66,7 +66,7 @@ bool bin_deserialize(Arena* arena, void* ctx, u8* end, u8** read, Str* val) {
 template <u8 CAPACITY>
 void bin_serialize(Arena* out, InlineStr<CAPACITY>* val) {
     *out->push<u8>() = val->count;
-    char* buffer = out->push_many<char>(val->count).elems;
+    char* buffer = out->push_many_uninit<char>(val->count).elems;
     MemCopy(buffer, val->elems, val->count);
 }
 
@@ -85,7 +85,7 @@ bool bin_deserialize(Arena* arena, void* ctx, u8* end, u8** read, InlineStr<CAPA
 
 #define ImplBinCopy(ty_)                                                          \
     void bin_serialize(Arena* out, ty_* val) {                                    \
-        MemCopy(out->push_unaligned<ty_>(), val, sizeof(ty_));                    \
+        MemCopy(out->push_unaligned_uninit<ty_>(), val, sizeof(ty_));             \
     }                                                                             \
     bool bin_deserialize(Arena* arena, void* ctx, u8* end, u8** read, ty_* val) { \
         if (*read + sizeof(ty_) > end) return false;                              \
@@ -140,7 +140,7 @@ forall(T) void bin_serialize(Arena* out, Vec<T>* val) {
 forall(T) bool bin_deserialize(Arena* arena, void* ctx, u8* end, u8** read, Vec<T>* val, usize p0_capacity) {
     u32 count = 0;
     if (!bin_deserialize(arena, ctx, end, read, &count)) return false;
-    *val = Vec<T>::make(arena, p0_capacity);
+    *val = Vec<T>::make(arena, max(p0_capacity, (usize)count));
     for (u32 i = 0; i < count; ++i) {
         if (!bin_deserialize(arena, ctx, end, read, val->push())) return false;
     }
@@ -151,7 +151,7 @@ forall(T) bool bin_deserialize(Arena* arena, void* ctx, u8* end, u8** read, Vec<
 
 forall(T) void bin_serialize(Arena* out, Slice<T>* val) {
     u32 count = val->count;
-    MemCopy(out->push_unaligned<u32>(), &count, sizeof(u32));
+    MemCopy(out->push_unaligned_uninit<u32>(), &count, sizeof(u32));
     for (u32 i = 0; i < val->count; ++i) {
         bin_serialize(out, &val->elems[i]);
     }
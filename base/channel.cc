@@ -1,9 +1,13 @@
 #include "inc.hh"
 namespace a {
 // -----------------------------------------------------------------------------
-#define This Channel<T>
+#define Template template <typename T, bool PADDED>
+#define This Channel_<T, PADDED>
+
+Template This This::make(Arena* arena, usize capacity) {
+    // reservations never go past capacity, so it only has to stay under the buffer bit.
+    AssertM(capacity < 0x80000000, "channel capacity is too large");
 
-forall(T) This This::make(Arena* arena, usize capacity) {
     T* buffers = arena->push_many<T>(2 * capacity).elems;
     This ret{};
     ret.capacity = capacity;
@@ -12,20 +16,109 @@ forall(T) This This::make(Arena* arena, usize capacity) {
     return ret;
 }
 
-forall(T) void This::push(T* item) {
-    u32 cur_buf_reserve = ::std::atomic_fetch_add_explicit(cur_buffer_reserve.ptr(), 1, ::std::memory_order_relaxed);
+Template void This::push(T* item) {
+    push_many(Slice<T>{item, 1});
+}
+
+Template bool This::try_push(T* item) {
+    return try_push_many(Slice<T>{item, 1}) == 1;
+}
+
+Template void This::push_many(Slice<T> items) {
+    // the epoch shares a line with the drain's writes, so it's only read once
+    // the channel has turned out to be full.
+    usize pushed = push_or_reject(items.elems, items.count);
+    while (pushed < items.count) {
+        u32 epoch = ::std::atomic_load_explicit(drain_epoch.ptr(), ::std::memory_order_acquire);
+        pushed += push_or_reject(items.elems + pushed, items.count - pushed);
+        if (pushed == items.count) return;
+
+        // pairs with the drain bumping the epoch before checking for blocked
+        // pushers, so either it sees us and wakes us or we see the new epoch.
+        ::std::atomic_fetch_add_explicit(blocked_pushers.ptr(), 1, ::std::memory_order_seq_cst);
+        futex_wait(&drain_epoch, epoch);
+        ::std::atomic_fetch_sub_explicit(blocked_pushers.ptr(), 1, ::std::memory_order_relaxed);
+    }
+}
+
+Template usize This::try_push_many(Slice<T> items) {
+    usize pushed = push_or_reject(items.elems, items.count);
+    if (pushed < items.count) {
+        ::std::atomic_fetch_add_explicit(rejected.ptr(), 1, ::std::memory_order_relaxed);
+    }
+    return pushed;
+}
+
+// reserves, copies and commits a whole run of items with one atomic each,
+// taking as many as there's room for.
+Template usize This::push_or_reject(T* items, usize count) {
+    if (count == 0) return 0;
+
+    // the reservation only ever advances as far as there's room, so however
+    // many producers pile onto a full channel the count can't creep up into the
+    // buffer bit. a drain swapping buffers just makes the exchange retry.
+    // seq_cst to pair with drain_wait, see wake_consumer_if_sleeping.
+    u32 cur_buf_reserve = ::std::atomic_load_explicit(cur_buffer_reserve.ptr(), ::std::memory_order_relaxed);
+    u32 want;
+    for (;;) {
+        u32 reserved_idx = cur_buf_reserve & 0x7fffffff;
+        if (reserved_idx >= capacity) return 0;
+        want = (u32)min(count, capacity - reserved_idx);
+
+        if (::std::atomic_compare_exchange_weak_explicit(cur_buffer_reserve.ptr(), &cur_buf_reserve, cur_buf_reserve + want, ::std::memory_order_seq_cst, ::std::memory_order_relaxed)) {
+            break;
+        }
+    }
     u32 buf = cur_buf_reserve & 0x80000000 ? 1 : 0;
     u32 reserved_idx = cur_buf_reserve & 0x7fffffff;
 
-    AssertM(reserved_idx < capacity, "channel is full");
+    MemCopy(&buffer[buf][reserved_idx], items, want * sizeof(T));
+
+    ::std::atomic_fetch_add_explicit(count_commit[buf].val.ptr(), want, ::std::memory_order_release);
+    wake_consumer_if_sleeping();
+    return want;
+}
+
+// the consumer flags itself as sleeping before its last look at the reservation
+// count, and producers reserve before checking the flag, so with both seq_cst a
+// push either gets seen by that look or sees the flag. the consumer snapshots
+// wake_epoch before that look too, so a bump that comes after it makes the futex
+// wait return straight away instead of missing the wake.
+Template void This::wake_consumer_if_sleeping() {
+    if (::std::atomic_load_explicit(consumer_sleeping.ptr(), ::std::memory_order_seq_cst)) {
+        ::std::atomic_fetch_add_explicit(wake_epoch.ptr(), 1, ::std::memory_order_seq_cst);
+        futex_wake_one(&wake_epoch);
+    }
+}
+
+Template This::Iter This::drain_wait(u32 spin_count) {
+    for (u32 i = 0;; ++i) {
+        u32 reserve = ::std::atomic_load_explicit(cur_buffer_reserve.ptr(), ::std::memory_order_relaxed);
+        if (reserve & 0x7fffffff) break;
+        if (::std::atomic_exchange_explicit(wake_pending.ptr(), 0, ::std::memory_order_acquire)) break;
 
-    T* target = &buffer[buf][reserved_idx];
-    *target = *item;
+        if (i < spin_count) {
+            cpu_relax();
+            continue;
+        }
 
-    ::std::atomic_fetch_add_explicit(count_commit[buf].ptr(), 1, ::std::memory_order_release);
+        ::std::atomic_store_explicit(consumer_sleeping.ptr(), 1, ::std::memory_order_seq_cst);
+        u32 epoch = ::std::atomic_load_explicit(wake_epoch.ptr(), ::std::memory_order_seq_cst);
+        reserve = ::std::atomic_load_explicit(cur_buffer_reserve.ptr(), ::std::memory_order_seq_cst);
+        if ((reserve & 0x7fffffff) == 0 && !::std::atomic_load_explicit(wake_pending.ptr(), ::std::memory_order_seq_cst)) {
+            futex_wait(&wake_epoch, epoch);
+        }
+        ::std::atomic_store_explicit(consumer_sleeping.ptr(), 0, ::std::memory_order_relaxed);
+    }
+    return Iter::make(this);
 }
 
-forall(T) This::Iter This::Iter::make(Channel<T>* chan) {
+Template void This::wake() {
+    ::std::atomic_store_explicit(wake_pending.ptr(), 1, ::std::memory_order_seq_cst);
+    wake_consumer_if_sleeping();
+}
+
+Template This::Iter This::Iter::make(This* chan) {
     u32 prev_peek = ::std::atomic_load_explicit(chan->cur_buffer_reserve.ptr(), ::std::memory_order_acquire);
     u32 new_value = prev_peek & 0x80000000 ? 0 : 0x80000000;
     u32 prev_buf_reserve = ::std::atomic_exchange_explicit(chan->cur_buffer_reserve.ptr(), new_value, ::std::memory_order_acq_rel);
@@ -33,12 +126,18 @@ forall(T) This::Iter This::Iter::make(Channel<T>* chan) {
     u32 prev_buf = prev_peek & 0x80000000 ? 1 : 0;
     u32 prev_reserved_idx = prev_buf_reserve & 0x7fffffff;
 
+    ::std::atomic_fetch_add_explicit(chan->drain_epoch.ptr(), 1, ::std::memory_order_seq_cst);
+    if (::std::atomic_load_explicit(chan->blocked_pushers.ptr(), ::std::memory_order_seq_cst) > 0) {
+        futex_wake_all(&chan->drain_epoch);
+    }
+
     for (;;) {
-        u32 check = ::std::atomic_load_explicit(chan->count_commit[prev_buf].ptr(), ::std::memory_order_acquire);
+        u32 check = ::std::atomic_load_explicit(chan->count_commit[prev_buf].val.ptr(), ::std::memory_order_acquire);
         if (check == prev_reserved_idx) break;
+        cpu_relax();
     }
 
-    *chan->count_commit[prev_buf] = 0;
+    *chan->count_commit[prev_buf].val = 0;
 
     This::Iter it = {};
     it.count = prev_reserved_idx;
@@ -49,7 +148,7 @@ forall(T) This::Iter This::Iter::make(Channel<T>* chan) {
     return it;
 }
 
-forall(T) void This::Iter::next() {
+Template void This::Iter::next() {
     if (++idx < count) {
         item = &buffer[idx];
     } else {
@@ -57,6 +156,118 @@ forall(T) void This::Iter::next() {
     }
 }
 
+#undef Template
+#undef This
+// -----------------------------------------------------------------------------
+#define This SegmentedChannel<T>
+
+forall(T) void This::create() {
+    ZeroStruct(this);
+    arena.create(64 * sizeof(Block));
+    arena.enable_chaining();
+
+    head = arena.push<Block>();
+    *tail = head;
+}
+
+forall(T) void This::destroy() {
+    arena.destroy();
+    ZeroStruct(this);
+}
+
+forall(T) void This::push(T* item) {
+    for (;;) {
+        Block* block = ::std::atomic_load_explicit(tail.ptr(), ::std::memory_order_acquire);
+        u32 idx = ::std::atomic_fetch_add_explicit(block->reserve.ptr(), 1, ::std::memory_order_relaxed);
+
+        if (idx < BLOCK_SIZE) {
+            block->items[idx] = *item;
+            ::std::atomic_store_explicit(block->ready[idx].ptr(), 1, ::std::memory_order_release);
+            return;
+        }
+
+        link_block_after(block);
+    }
+}
+
+// whoever finds a block full makes sure something follows it. the block might
+// have been retired and relinked since this producer loaded it, so it only
+// counts as full if it's still the tail and still over its count.
+forall(T) void This::link_block_after(Block* full) {
+    lock.lock();
+
+    if (::std::atomic_load_explicit(tail.ptr(), ::std::memory_order_relaxed) == full &&
+        ::std::atomic_load_explicit(full->reserve.ptr(), ::std::memory_order_relaxed) >= BLOCK_SIZE) {
+        Block* block = free_blocks;
+        if (block) {
+            free_blocks = ::std::atomic_load_explicit(block->next.ptr(), ::std::memory_order_relaxed);
+            ::std::atomic_store_explicit(block->next.ptr(), nullptr, ::std::memory_order_relaxed);
+            // the fetch_add of a producer still holding this block from a past
+            // life can land after this, but then it simply gets a valid slot.
+            ::std::atomic_store_explicit(block->reserve.ptr(), 0, ::std::memory_order_relaxed);
+        } else {
+            block = arena.push<Block>();
+        }
+
+        ::std::atomic_store_explicit(full->next.ptr(), block, ::std::memory_order_release);
+        ::std::atomic_store_explicit(tail.ptr(), block, ::std::memory_order_release);
+    }
+
+    lock.unlock();
+}
+
+// items handed out by the last drain stay valid until now, so this is when the
+// blocks it emptied can go back to the producers. their reserve counts are left
+// over BLOCK_SIZE, which keeps stale producers off them until they're relinked.
+forall(T) This::Iter This::Iter::make(SegmentedChannel<T>* chan) {
+    if (chan->retired) {
+        Block* last = chan->retired;
+        for (;;) {
+            memset(last->ready, 0, sizeof(last->ready));
+            Block* next = ::std::atomic_load_explicit(last->next.ptr(), ::std::memory_order_relaxed);
+            if (!next) break;
+            last = next;
+        }
+
+        chan->lock.lock();
+        ::std::atomic_store_explicit(last->next.ptr(), chan->free_blocks, ::std::memory_order_relaxed);
+        chan->free_blocks = chan->retired;
+        chan->lock.unlock();
+
+        chan->retired = nullptr;
+    }
+
+    This::Iter it = {};
+    it.chan = chan;
+    it.next();
+    return it;
+}
+
+forall(T) void This::Iter::next() {
+    for (;;) {
+        Block* block = chan->head;
+
+        if (chan->head_idx < BLOCK_SIZE) {
+            u32 idx = chan->head_idx;
+            if (!::std::atomic_load_explicit(block->ready[idx].ptr(), ::std::memory_order_acquire)) break;
+            item = &block->items[idx];
+            chan->head_idx++;
+            return;
+        }
+
+        Block* next = ::std::atomic_load_explicit(block->next.ptr(), ::std::memory_order_acquire);
+        if (!next) break;
+
+        ::std::atomic_store_explicit(block->next.ptr(), chan->retired, ::std::memory_order_relaxed);
+        chan->retired = block;
+        chan->head = next;
+        chan->head_idx = 0;
+    }
+
+    done = true;
+    item = nullptr;
+}
+
 #undef This
 // -----------------------------------------------------------------------------
 #if TEST
@@ -66,20 +277,22 @@ forall(T) void This::Iter::next() {
 global ::std::atomic_bool test_channel_start;
 global ::std::atomic_bool test_channel_done;
 
+template <bool PADDED = true>
 void* test_channel_push_thread(void* arg) {
     while (!test_channel_start);
 
-    Channel<u64>* chan = (Channel<u64>*)arg;
+    Channel_<u64, PADDED>* chan = (Channel_<u64, PADDED>*)arg;
     for (u64 i = 1; i <= NUM_ITEMS; ++i) {
         chan->push(&i);
     }
     return nullptr;
 }
 
+template <bool PADDED = true>
 void* test_channel_drain_thread(void* arg) {
     while (!test_channel_start);
 
-    Channel<u64>* chan = (Channel<u64>*)arg;
+    Channel_<u64, PADDED>* chan = (Channel_<u64, PADDED>*)arg;
     u64 sum = 0;
     bool should_finish = false;
 
@@ -133,6 +346,397 @@ void test_channel() {
 
 #undef THREAD_COUNT
 #undef NUM_ITEMS
+
+#define THREAD_COUNT 8
+#define NUM_ITEMS 4096
+
+global ::std::atomic_ullong test_channel_rejections;
+
+// odd threads shed load with try_push and retry, even threads block in push,
+// and every fourth thread does either in batches.
+void* test_channel_backpressure_push_thread(void* arg) {
+    while (!test_channel_start);
+
+    Channel<u64>* chan = *(Channel<u64>**)arg;
+    u64 thread_idx = ((u64*)arg)[1];
+    bool blocking = thread_idx % 2 == 0;
+    usize batch_size = thread_idx % 4 < 2 ? 1 : 24;
+
+    u64 batch[24];
+    for (u64 i = 1; i <= NUM_ITEMS;) {
+        usize count = min((u64)batch_size, NUM_ITEMS + 1 - i);
+        for (usize j = 0; j < count; ++j) batch[j] = i + j;
+        Slice<u64> items = {batch, count};
+        i += count;
+
+        if (blocking) {
+            chan->push_many(items);
+            continue;
+        }
+        for (;;) {
+            usize pushed = chan->try_push_many(items);
+            if (pushed == items.count) break;
+            items = Slice<u64>{items.elems + pushed, items.count - pushed};
+            test_channel_rejections++;
+            sched_yield();
+        }
+    }
+    return nullptr;
+}
+
+void test_channel_backpressure() {
+    ScratchArena scratch{};
+
+    test_channel_start = false;
+    test_channel_done = false;
+    test_channel_rejections = 0;
+
+    // far smaller than what's pushed between drains, so the channel is full most of the time.
+    Channel<u64> chan = Channel<u64>::make(scratch.arena, 64);
+
+    pthread_t threads[THREAD_COUNT];
+    pthread_t drain_thread;
+    u64 args[THREAD_COUNT][2];
+
+    pthread_create(&drain_thread, NULL, test_channel_drain_thread, (void*)&chan);
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        args[i][0] = (u64)&chan;
+        args[i][1] = i;
+        pthread_create(&threads[i], NULL, test_channel_backpressure_push_thread, (void*)args[i]);
+    }
+
+    test_channel_start = true;
+
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    test_channel_done = true;
+
+    void* result;
+    pthread_join(drain_thread, &result);
+    u64 sum = (u64)result;
+
+    u64 expected_sum = (u64)THREAD_COUNT * (NUM_ITEMS * (NUM_ITEMS + 1)) / 2;
+    AssertM(sum == expected_sum, "expected %llu but got %llu\n", expected_sum, sum);
+    AssertM(chan.rejected_pushes() == test_channel_rejections, "rejected push count is off");
+}
+
+#undef THREAD_COUNT
+#undef NUM_ITEMS
+
+#define THREAD_COUNT 4
+#define NUM_BURSTS 16
+#define BURST_SIZE 256
+
+// producers push in bursts with idle gaps, so the consumer keeps going to sleep.
+void* test_channel_drain_wait_push_thread(void* arg) {
+    Channel<u64>* chan = (Channel<u64>*)arg;
+    for (u64 burst = 0; burst < NUM_BURSTS; ++burst) {
+        usleep(1000);
+        for (u64 i = 1; i <= BURST_SIZE; ++i) {
+            chan->push(&i);
+        }
+    }
+    return nullptr;
+}
+
+void* test_channel_drain_wait_thread(void* arg) {
+    Channel<u64>* chan = (Channel<u64>*)arg;
+    u64 sum = 0;
+    while (!test_channel_done) {
+        foreach (it, chan->drain_wait(64)) {
+            sum += *it.item;
+        }
+    }
+    foreach (it, chan->drain()) {
+        sum += *it.item;
+    }
+    return (void*)(u64)sum;
+}
+
+void test_channel_drain_wait() {
+    ScratchArena scratch{};
+
+    test_channel_done = false;
+    Channel<u64> chan = Channel<u64>::make(scratch.arena, 1024);
+
+    pthread_t threads[THREAD_COUNT];
+    pthread_t drain_thread;
+
+    pthread_create(&drain_thread, NULL, test_channel_drain_wait_thread, (void*)&chan);
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        pthread_create(&threads[i], NULL, test_channel_drain_wait_push_thread, (void*)&chan);
+    }
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    test_channel_done = true;
+    chan.wake();
+
+    void* result;
+    pthread_join(drain_thread, &result);
+    u64 sum = (u64)result;
+
+    u64 expected_sum = (u64)THREAD_COUNT * NUM_BURSTS * (BURST_SIZE * (BURST_SIZE + 1)) / 2;
+    AssertM(sum == expected_sum, "expected %llu but got %llu\n", expected_sum, sum);
+}
+
+#undef THREAD_COUNT
+#undef NUM_BURSTS
+#undef BURST_SIZE
+
+#define THREAD_COUNT 32
+#define NUM_ITEMS 32768
+#define BATCH_SIZE 64
+
+template <bool PADDED = true>
+void* test_channel_push_many_thread(void* arg) {
+    while (!test_channel_start);
+
+    Channel_<u64, PADDED>* chan = (Channel_<u64, PADDED>*)arg;
+    u64 batch[BATCH_SIZE];
+    for (u64 i = 1; i <= NUM_ITEMS; i += BATCH_SIZE) {
+        for (u64 j = 0; j < BATCH_SIZE; ++j) batch[j] = i + j;
+        chan->push_many(SliceFromRawArray(u64, batch));
+    }
+    return nullptr;
+}
+
+// push throughput with every producer hammering the channel at once, which is
+// what suffers when the shared counters sit on the same cache line, and again
+// with producers pushing in batches. the unpadded layout runs alongside to show
+// what the padding is worth.
+template <bool PADDED>
+void test_channel_contention_run(bool batched) {
+    ScratchArena scratch{};
+
+    test_channel_start = false;
+    test_channel_done = false;
+
+    Channel_<u64, PADDED> chan = Channel_<u64, PADDED>::make(scratch.arena, THREAD_COUNT * NUM_ITEMS);
+
+    pthread_t threads[THREAD_COUNT];
+    pthread_t drain_thread;
+
+    pthread_create(&drain_thread, NULL, test_channel_drain_thread<PADDED>, (void*)&chan);
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        pthread_create(&threads[i], NULL, batched ? test_channel_push_many_thread<PADDED> : test_channel_push_thread<PADDED>, (void*)&chan);
+    }
+
+    u64 start_ticks = timing_get_ticks();
+    test_channel_start = true;
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    u64 ticks = timing_get_ticks() - start_ticks;
+
+    test_channel_done = true;
+
+    void* result;
+    pthread_join(drain_thread, &result);
+    u64 sum = (u64)result;
+
+    u64 expected_sum = (u64)THREAD_COUNT * (NUM_ITEMS * (NUM_ITEMS + 1)) / 2;
+    AssertM(sum == expected_sum, "expected %llu but got %llu\n", expected_sum, sum);
+
+    cchar* label = batched ? (PADDED ? "push_many x64, 32 producers" : "  same, unpadded") : (PADDED ? "push, 32 producers" : "  same, unpadded");
+    test_report_throughput(label, (u64)THREAD_COUNT * NUM_ITEMS, ticks);
+}
+
+void test_channel_contention() {
+    static_assert(NUM_ITEMS % BATCH_SIZE == 0);
+
+    for (int batched = 0; batched < 2; ++batched) {
+        test_channel_contention_run<true>(batched);
+        test_channel_contention_run<false>(batched);
+    }
+}
+
+#undef BATCH_SIZE
+
+void* test_segmented_channel_push_thread(void* arg) {
+    while (!test_channel_start);
+
+    SegmentedChannel<u64>* chan = (SegmentedChannel<u64>*)arg;
+    for (u64 i = 1; i <= NUM_ITEMS; ++i) {
+        chan->push(&i);
+        if (i % 4096 == 0) sched_yield();
+    }
+    return nullptr;
+}
+
+void* test_segmented_channel_drain_thread(void* arg) {
+    while (!test_channel_start);
+
+    SegmentedChannel<u64>* chan = (SegmentedChannel<u64>*)arg;
+    u64 sum = 0;
+    bool should_finish = false;
+
+    for (;;) {
+        foreach (it, chan->drain()) {
+            Assert(*it.item);
+            sum += *it.item;
+        }
+
+        if (should_finish) break;
+        if (test_channel_done) should_finish = true;
+    }
+
+    return (void*)(u64)sum;
+}
+
+void test_segmented_channel() {
+    for (int i = 0; i < 4; ++i) {
+        test_channel_start = false;
+        test_channel_done = false;
+
+        SegmentedChannel<u64> chan;
+        chan.create();
+
+        pthread_t threads[THREAD_COUNT];
+        pthread_t drain_thread;
+
+        pthread_create(&drain_thread, NULL, test_segmented_channel_drain_thread, (void*)&chan);
+        for (u64 i = 0; i < THREAD_COUNT; ++i) {
+            pthread_create(&threads[i], NULL, test_segmented_channel_push_thread, (void*)&chan);
+        }
+
+        test_channel_start = true;
+
+        for (u64 i = 0; i < THREAD_COUNT; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+
+        test_channel_done = true;
+
+        void* result;
+        pthread_join(drain_thread, &result);
+        u64 sum = (u64)result;
+
+        u64 expected_sum = (u64)THREAD_COUNT * (NUM_ITEMS * (NUM_ITEMS + 1)) / 2;
+        AssertM(sum == expected_sum, "expected %llu but got %llu\n", expected_sum, sum);
+
+        chan.destroy();
+    }
+}
+
+#undef THREAD_COUNT
+#undef NUM_ITEMS
+
+// -----------------------------------------------------------------------------
+// Benchmarks, not part of test_base since they take a while. Each configuration
+// prints one JSON object per line on stdout, so runs can be diffed or loaded up
+// elsewhere to catch regressions.
+
+#define BENCH_ITEMS_PER_RUN (1 << 18)
+#define BENCH_CAPACITY 16384
+#define BENCH_MAX_PRODUCERS 16
+
+// the timestamp is taken just before the push, so latency covers the push,
+// waiting to be drained, and the drain itself.
+template <usize SIZE>
+struct BenchChannelItem {
+    u64 pushed_ticks;
+    u8 payload[SIZE - sizeof(u64)];
+};
+
+template <>
+struct BenchChannelItem<sizeof(u64)> {
+    u64 pushed_ticks;
+};
+
+template <usize SIZE>
+struct BenchChannelCtx {
+    Channel<BenchChannelItem<SIZE>>* chan;
+    u64 count;
+};
+
+global ::std::atomic_bool bench_channel_start;
+
+template <usize SIZE>
+void* bench_channel_push_thread(void* arg) {
+    BenchChannelCtx<SIZE>* ctx = (BenchChannelCtx<SIZE>*)arg;
+    BenchChannelItem<SIZE> item = {};
+    while (!bench_channel_start) cpu_relax();
+
+    for (u64 i = 0; i < ctx->count; ++i) {
+        item.pushed_ticks = timing_get_ticks();
+        if constexpr (SIZE > sizeof(u64)) item.payload[0] = (u8)i;
+        ctx->chan->push(&item);
+    }
+    return nullptr;
+}
+
+int bench_channel_compare_u64(const void* a, const void* b) {
+    u64 x = *(u64*)a, y = *(u64*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+template <usize SIZE>
+void bench_channel_run(u32 producers) {
+    static_assert(sizeof(BenchChannelItem<SIZE>) == SIZE);
+    ScratchArena scratch{};
+
+    Channel<BenchChannelItem<SIZE>> chan = Channel<BenchChannelItem<SIZE>>::make(scratch.arena, BENCH_CAPACITY);
+    u64 per_producer = BENCH_ITEMS_PER_RUN / producers;
+    u64 total = per_producer * producers;
+    Slice<u64> latencies = scratch.arena->push_many_uninit<u64>(total);
+
+    bench_channel_start = false;
+    pthread_t threads[BENCH_MAX_PRODUCERS];
+    BenchChannelCtx<SIZE> ctx = {&chan, per_producer};
+    for (u32 i = 0; i < producers; ++i) {
+        pthread_create(&threads[i], NULL, bench_channel_push_thread<SIZE>, &ctx);
+    }
+
+    u64 start_ticks = timing_get_ticks();
+    bench_channel_start = true;
+
+    u64 received = 0;
+    while (received < total) {
+        usize before = received;
+        foreach (it, chan.drain()) {
+            latencies.elems[received++] = timing_get_ticks() - it.item->pushed_ticks;
+        }
+        if (received == before) cpu_relax();
+    }
+    u64 elapsed_ticks = timing_get_ticks() - start_ticks;
+
+    for (u32 i = 0; i < producers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    qsort(latencies.elems, latencies.count, sizeof(u64), bench_channel_compare_u64);
+    auto percentile = [&](double p) { return timing_ticks_to_nanos(latencies.elems[(usize)(p * (double)(total - 1))]); };
+
+    u64 elapsed_nanos = max(timing_ticks_to_nanos(elapsed_ticks), 1ull);
+    printf(
+        "{\"bench\":\"channel\",\"producers\":%u,\"item_size\":%zu,\"items\":%llu,\"capacity\":%u,"
+        "\"elapsed_ns\":%llu,\"items_per_sec\":%.0f,\"bytes_per_sec\":%.0f,"
+        "\"latency_p50_ns\":%llu,\"latency_p99_ns\":%llu,\"latency_p999_ns\":%llu,\"latency_max_ns\":%llu}\n",
+        producers, SIZE, total, BENCH_CAPACITY,
+        elapsed_nanos, 1e9 * (double)total / (double)elapsed_nanos, 1e9 * (double)(total * SIZE) / (double)elapsed_nanos,
+        percentile(0.5), percentile(0.99), percentile(0.999), percentile(1.0)
+    );
+    fflush(stdout);
+}
+
+void bench_channel() {
+    u32 cores = (u32)max(1l, sysconf(_SC_NPROCESSORS_ONLN));
+    u32 max_producers = min((u32)BENCH_MAX_PRODUCERS, max(2 * cores, 4u));
+
+    for (u32 producers = 1; producers <= max_producers; producers *= 2) {
+        bench_channel_run<8>(producers);
+        bench_channel_run<64>(producers);
+        bench_channel_run<256>(producers);
+    }
+}
+
+#undef BENCH_ITEMS_PER_RUN
+#undef BENCH_CAPACITY
+#undef BENCH_MAX_PRODUCERS
 #endif
 // -----------------------------------------------------------------------------
 }  // namespace a
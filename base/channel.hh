@@ -6,9 +6,25 @@ namespace a {
 // Multi-producer single-consumer channel for communicating between threads
 //
 // Anyone can push onto the channel from any thread at any time, but the same
-// thread should always be responsible for draining it.
+// thread should always be responsible for draining it. Once capacity items are
+// waiting to be drained the channel is full: push then waits for the next drain
+// and try_push gives up, so producers can choose to throttle or shed load.
+// A consumer with nothing else to do can use drain_wait to sleep until there's
+// something to drain.
+//
+// PADDED puts the counters that producers and the consumer hammer on separate
+// cache lines. It's only ever turned off so the contention test can measure
+// what that's worth, so use the Channel alias.
+
+#define Template template <typename T, bool PADDED>
+
+Template class Channel_ {
+    konst usize LINE_ALIGN = PADDED ? CACHE_LINE_SIZE : alignof(AtomicVal<u32>);
+
+    struct alignas(LINE_ALIGN) CommitCount {
+        AtomicVal<u32> val;
+    };
 
-forall(T) class Channel {
     class Iter {
         u32 count;
         u32 idx;
@@ -17,25 +33,117 @@ forall(T) class Channel {
       public:
         bool done;
         T* item;
-        func Iter make(Channel<T>* chan);
+        func Iter make(Channel_* chan);
         void next();
     };
 
+    // every push reads these and bumps two of the counters below, so each
+    // counter gets its own cache line to keep producers from invalidating the
+    // read-only fields or the consumer's spin on the other buffer's commits.
     usize capacity;
-    AtomicVal<u32> count_commit[2];
-    AtomicVal<u32> cur_buffer_reserve;
     T* buffer[2];
+    AtomicVal<u32> consumer_sleeping;
+    alignas(LINE_ALIGN) AtomicVal<u32> cur_buffer_reserve;
+    CommitCount count_commit[2];
+    alignas(LINE_ALIGN) AtomicVal<u32> drain_epoch;
+    AtomicVal<u32> blocked_pushers;
+    AtomicVal<u32> wake_pending;
+    AtomicVal<u32> wake_epoch;  // what drain_wait sleeps on, bumped before every wake
+    AtomicVal<u64> rejected;
 
   public:
-    func Channel make(Arena* arena, usize capacity);
+    func Channel_ make(Arena* arena, usize capacity);
     void push(T* item);
+    bool try_push(T* item);
+
+    // same as above but for a run of items, reserving and committing space for
+    // the lot at once. try_push_many returns how many of them fit.
+    void push_many(Slice<T> items);
+    usize try_push_many(Slice<T> items);
     Iter drain() { return Iter::make(this); }
+
+    // spins for up to spin_count checks for pushed items before going to sleep
+    // until a producer wakes it, then drains. also returns, possibly with nothing
+    // drained, after a call to wake.
+    Iter drain_wait(u32 spin_count = 1024);
+    void wake();
+
+    // how many times try_push or try_push_many has found the channel full.
+    u64 rejected_pushes() { return ::std::atomic_load_explicit(rejected.ptr(), ::std::memory_order_relaxed); }
+
+  private:
+    usize push_or_reject(T* items, usize count);
+    void wake_consumer_if_sleeping();
+};
+
+template <typename T>
+using Channel = Channel_<T, true>;
+
+#undef Template
+
+// -----------------------------------------------------------------------------
+
+// Unbounded multi-producer single-consumer channel
+//
+// Same contract as Channel, but instead of preallocating for the worst case it
+// links on fixed size blocks from its own arena as they fill up. Blocks the
+// consumer has finished with are reused once the drain after the one that
+// emptied them begins, so memory use tracks the backlog rather than the total
+// ever pushed. Draining stops at the first item a producer hasn't finished
+// writing yet, and anything behind it is picked up by a later drain.
+
+forall(T) class SegmentedChannel {
+    konst u32 BLOCK_SIZE = 512;
+
+    struct Block {
+        // slots handed out so far, which keeps counting past BLOCK_SIZE while
+        // producers wait for the next block to be linked on.
+        alignas(CACHE_LINE_SIZE) AtomicVal<u32> reserve;
+        AtomicVal<Block*> next;
+        AtomicVal<u8> ready[BLOCK_SIZE];
+        T items[BLOCK_SIZE];
+    };
+
+    class Iter {
+        SegmentedChannel<T>* chan;
+
+      public:
+        bool done;
+        T* item;
+        func Iter make(SegmentedChannel<T>* chan);
+        void next();
+    };
+
+    Arena arena;
+    SpinLock lock;  // guards arena, free_blocks and linking on new blocks
+    Block* free_blocks;
+    alignas(CACHE_LINE_SIZE) AtomicVal<Block*> tail;
+
+    // only touched by the consumer
+    alignas(CACHE_LINE_SIZE) Block* head;
+    u32 head_idx;
+    Block* retired;
+
+  public:
+    void create();
+    void destroy();
+
+    void push(T* item);
+    Iter drain() { return Iter::make(this); }
+
+  private:
+    void link_block_after(Block* full);
 };
 
 // -----------------------------------------------------------------------------
 
 #if TEST
 void test_channel();
+void test_channel_backpressure();
+void test_channel_drain_wait();
+void test_channel_contention();
+void test_segmented_channel();
+void bench_channel();
 #endif
 
 // -----------------------------------------------------------------------------
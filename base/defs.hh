@@ -98,7 +98,7 @@ namespace a {
 #define DebugAssertM(...) AssertM(__VA_ARGS__)
 #else
 #define DebugAssert(x)
-#define DebugAssertM(x)
+#define DebugAssertM(...)
 #endif
 
 consteval u64 operator""_kb(u64 n) { return n << 10; }
@@ -154,6 +154,19 @@ forall(T) struct AtomicVal {
     ::std::atomic<T>* ptr() { return (::std::atomic<T>*)&this->unsafe_inner; }
 };
 
+// apple's arm cores pull lines in as 128 byte pairs, so padding hot atomics to
+// 64 bytes there still leaves them sharing.
+#if PLATFORM_APPLE && defined(__aarch64__)
+konst usize CACHE_LINE_SIZE = 128;
+#else
+konst usize CACHE_LINE_SIZE = 64;
+#endif
+
+// gives a value a cache line to itself.
+forall(T) struct alignas(CACHE_LINE_SIZE) CacheAligned {
+    T val;
+};
+
 #define Swap(a, b)     \
     do {               \
         auto temp = b; \
@@ -169,6 +182,8 @@ forall(T) int sign(T a) { return a >= 0 ? 1 : -1; }
 int next_power_of_2(int a) { return a <= 1 ? 1 : 1u << (32 - __builtin_clz(a - 1)); }
 int count_leading_zeroes(u64 a) { return __builtin_clzll(a); }
 int count_leading_zeroes(u32 a) { return __builtin_clz(a); }
+int count_trailing_zeroes(u64 a) { return __builtin_ctzll(a); }
+int count_trailing_zeroes(u32 a) { return __builtin_ctz(a); }
 
 forall(T, U) U bit_cast(T a) {
     static_assert(sizeof(T) == sizeof(U));
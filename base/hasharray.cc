@@ -1,8 +1,8 @@
 #include "inc.hh"
 namespace a {
 // -----------------------------------------------------------------------------
-#define Template template <typename K, typename V, bool PREHASHED>
-#define This HashArray_<K, V, PREHASHED>
+#define Template template <typename K, typename V, bool PREHASHED, bool VERIFY_KEYS>
+#define This HashArray_<K, V, PREHASHED, VERIFY_KEYS>
 
 Template This This::make(Arena* arena, u64 capacity, u64 max_elems) {
     u64* hashes = arena->push_many<u64>(capacity).elems;
@@ -35,7 +35,8 @@ Template This This::make_with_elems(Arena* arena, u64 max_elems) {
     return This::make(arena, capacity, max_elems);
 }
 
-Template u64 This::find_idx(K* key) {
+// 0 and 1 mark empty slots and tombstones, so real hashes get moved out of the way.
+Template u64 This::hash_key(K* key) {
     u64 hash;
     if constexpr (PREHASHED) {
         hash = key->hash;
@@ -43,45 +44,129 @@ Template u64 This::find_idx(K* key) {
         hash = hash64_bytes((u8*)key, sizeof(K));
     }
     if (hash < 2) hash += 2;
+    return hash;
+}
+
+Template bool This::keys_equal(K* a, K* b) {
+    if constexpr (!VERIFY_KEYS) {
+        static_assert(PREHASHED, "unverified keys must be prehashed");
+        return true;
+    } else if constexpr (requires { a->eq(b); }) {
+        return a->eq(b);
+    } else {
+        return memcmp(a, b, sizeof(K)) == 0;
+    }
+}
+
+Template This This::make_growable(Arena* arena, u64 capacity) {
+    This map = This::make_with_cap(arena, capacity);
+    map.grow_arena = arena;
+    return map;
+}
+
+Template u64 This::find_idx_in(u64* hashes, K* keys, u64 capacity, K* key, u64 hash) {
     u64 start_idx = hash & (capacity - 1);
     u64 i;
 
     for (i = start_idx; i < capacity; ++i) {
         if (hashes[i] == 0) return UINT64_MAX;
-        if (hashes[i] == hash) return i;
+        if (hashes[i] == hash && keys_equal(&keys[i], key)) return i;
     }
     for (i = 0; i < start_idx; ++i) {
         if (hashes[i] == 0) return UINT64_MAX;
-        if (hashes[i] == hash) return i;
+        if (hashes[i] == hash && keys_equal(&keys[i], key)) return i;
     }
 
     return UINT64_MAX;
 }
 
-Template V* This::insert(K* key) {
-    AssertM(count < max_elems, "hasharray is full");
-
-    u64 hash;
-    if constexpr (PREHASHED) {
-        hash = key->hash;
-    } else {
-        hash = hash64_bytes((u8*)key, sizeof(K));
-    }
-    if (hash < 2) hash += 2;
-
+Template u64 This::free_idx_in(u64* hashes, u64 capacity, u64 hash) {
     u64 start_idx = hash & (capacity - 1);
     u64 i;
 
     for (i = start_idx; i < capacity; ++i) {
-        if (hashes[i] < 2) goto found;
+        if (hashes[i] < 2) return i;
     }
     for (i = 0; i < start_idx; ++i) {
-        if (hashes[i] < 2) goto found;
+        if (hashes[i] < 2) return i;
     }
 
     AssertUnreachable();
+}
+
+Template V* This::find(K* key) {
+    u64 hash = hash_key(key);
+
+    u64 i = find_idx_in(hashes, keys, capacity, key, hash);
+    if (i < UINT64_MAX) return &values[i];
+
+    if (old_capacity) {
+        i = find_idx_in(old_hashes, old_keys, old_capacity, key, hash);
+        if (i < UINT64_MAX) return &old_values[i];
+    }
+
+    return nullptr;
+}
+
+// Moves the next few slots of the old table into the live one, leaving
+// tombstones behind so lookups in the old table still probe past them.
+Template void This::migrate(u64 slots) {
+    u64 end = min(migrate_idx + slots, old_capacity);
+
+    for (; migrate_idx < end && old_count > 0; ++migrate_idx) {
+        u64 hash = old_hashes[migrate_idx];
+        if (hash < 2) continue;
+
+        u64 i = free_idx_in(hashes, capacity, hash);
+        hashes[i] = hash;
+        keys[i] = old_keys[migrate_idx];
+        values[i] = old_values[migrate_idx];
+
+        old_hashes[migrate_idx] = 1;
+        old_count--;
+    }
+
+    if (migrate_idx == old_capacity || old_count == 0) {
+        old_hashes = nullptr;
+        old_keys = nullptr;
+        old_values = nullptr;
+        old_capacity = 0;
+    }
+}
+
+// count covers both tables, so checking it against the live table's max_elems
+// guarantees everything left to migrate still fits. A new table holds twice as
+// many elements as the one it replaces, and MIGRATE_SLOTS_PER_OP is enough to
+// empty the old table before the new one fills, so the finishing migrate call
+// below is only a backstop.
+Template void This::grow_if_full() {
+    if (old_capacity) migrate(MIGRATE_SLOTS_PER_OP);
+    if (!grow_arena || count < max_elems) return;
+
+    if (old_capacity) migrate(old_capacity);
+
+    old_hashes = hashes;
+    old_keys = keys;
+    old_values = values;
+    old_capacity = capacity;
+    old_count = count;
+    migrate_idx = 0;
+
+    capacity *= 2;
+    max_elems = capacity * LOAD_FACTOR_PERCENT / 100;
+
+    hashes = grow_arena->push_many<u64>(capacity).elems;
+    keys = grow_arena->push_many<K>(capacity).elems;
+    values = grow_arena->push_many<V>(capacity).elems;
+}
+
+Template V* This::insert(K* key) {
+    grow_if_full();
+    AssertM(count < max_elems, "hasharray is full");
+
+    u64 hash = hash_key(key);
+    u64 i = free_idx_in(hashes, capacity, hash);
 
-found:
     count++;
     hashes[i] = hash;
     keys[i] = *key;
@@ -91,38 +176,44 @@ found:
 }
 
 Template V* This::maybe_get(K* key) {
-    u64 i = find_idx(key);
-    return i == UINT64_MAX ? nullptr : &values[i];
+    return find(key);
 }
 
 Template V* This::get(K* key) {
-    u64 i = find_idx(key);
-    return i == UINT64_MAX ? value_stub : &values[i];
+    V* value = find(key);
+    return value ? value : value_stub;
 }
 
 Template V* This::entry(K* key) {
-    u64 hash;
-    if constexpr (PREHASHED) {
-        hash = key->hash;
-    } else {
-        hash = hash64_bytes((u8*)key, sizeof(K));
+    grow_if_full();
+
+    u64 hash = hash_key(key);
+
+    // a key still waiting in the old table is moved over now rather than
+    // inserted a second time.
+    if (old_capacity) {
+        u64 old_idx = find_idx_in(old_hashes, old_keys, old_capacity, key, hash);
+        if (old_idx < UINT64_MAX) {
+            u64 i = free_idx_in(hashes, capacity, hash);
+            hashes[i] = hash;
+            keys[i] = old_keys[old_idx];
+            values[i] = old_values[old_idx];
+
+            old_hashes[old_idx] = 1;
+            old_count--;
+            return &values[i];
+        }
     }
-    if (hash < 2) hash += 2;
 
     u64 start_idx = hash & (capacity - 1);
-    u64 tombstone_idx = UINT64_MAX;
     u64 i;
 
-#define X()                                                     \
-    {                                                           \
-        u64 stored_hash = hashes[i];                            \
-        if (stored_hash > 1) {                                  \
-            if (stored_hash == hash) return &values[i];         \
-        } else if (stored_hash == 1) {                          \
-            if (tombstone_idx == UINT64_MAX) tombstone_idx = i; \
-        } else {                                                \
-            goto not_found;                                     \
-        }                                                       \
+#define X()                                                   \
+    {                                                         \
+        u64 stored_hash = hashes[i];                          \
+        if (stored_hash == 0) goto not_found;                 \
+        if (stored_hash == hash &&                            \
+            keys_equal(&keys[i], key)) return &values[i];     \
     }
     for (i = start_idx; i < capacity; ++i) X();
     for (i = 0; i < start_idx; ++i) X();
@@ -132,7 +223,6 @@ Template V* This::entry(K* key) {
 
 not_found:
     AssertM(count < max_elems, "hasharray is full");
-    if (tombstone_idx < UINT64_MAX) i = tombstone_idx;
 
     count++;
     hashes[i] = hash;
@@ -143,39 +233,127 @@ not_found:
 }
 
 Template bool This::remove(K* key) {
-    u64 i = find_idx(key);
-    if (i == UINT64_MAX) return false;
+    if (old_capacity) migrate(MIGRATE_SLOTS_PER_OP);
+
+    u64 hash = hash_key(key);
 
-    count--;
-    hashes[i] = 1;  // tombstone
-    return true;
+    u64 i = find_idx_in(hashes, keys, capacity, key, hash);
+    if (i < UINT64_MAX) {
+        count--;
+        remove_shift(i);
+        return true;
+    }
+
+    // the old table keeps tombstones, since shifting slots back could move
+    // them behind migrate_idx where they'd never be migrated.
+    if (old_capacity) {
+        i = find_idx_in(old_hashes, old_keys, old_capacity, key, hash);
+        if (i < UINT64_MAX) {
+            count--;
+            old_count--;
+            old_hashes[i] = 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Walks the probe run after the hole, moving back any element whose home slot
+// is at or before the hole. The live table never holds tombstones, so a run
+// always ends at an empty slot.
+Template void This::remove_shift(u64 hole) {
+    u64 mask = capacity - 1;
+
+    for (u64 i = (hole + 1) & mask;; i = (i + 1) & mask) {
+        u64 hash = hashes[i];
+        if (hash == 0) break;
+
+        u64 home = hash & mask;
+        if (((i - home) & mask) < ((i - hole) & mask)) continue;
+
+        hashes[hole] = hash;
+        keys[hole] = keys[i];
+        values[hole] = values[i];
+        hole = i;
+    }
+
+    hashes[hole] = 0;
 }
 
 Template void This::clear() {
     count = 0;
     ZeroArray(hashes, capacity);
+
+    old_hashes = nullptr;
+    old_keys = nullptr;
+    old_values = nullptr;
+    old_capacity = 0;
+    old_count = 0;
+}
+
+Template void This::count_probe_lengths(Slice<u64> histogram, u64* hashes, u64 capacity) {
+    for (u64 i = 0; i < capacity; ++i) {
+        u64 hash = hashes[i];
+        if (hash < 2) continue;
+
+        u64 dist = (i - hash) & (capacity - 1);
+        histogram[min(dist, (u64)histogram.count - 1)]++;
+    }
 }
 
+// Slot i counts the elements i slots past their home slot, with the last slot
+// also counting everything further out.
+Template Slice<u64> This::probe_histogram(Arena* out, usize max_len) {
+    Assert(max_len > 0);
+    Slice<u64> histogram = out->push_many<u64>(max_len);
+
+    count_probe_lengths(histogram, hashes, capacity);
+    if (old_capacity) count_probe_lengths(histogram, old_hashes, old_capacity);
+
+    return histogram;
+}
+
+// The live table is walked starting from an empty slot. No probe run crosses
+// an empty slot, so a removal only ever shifts elements the Iter hasn't
+// reached yet back into the slot it's on.
 Template This::Iter This::Iter::make(This* map) {
     This::Iter ret = {};
     ret.idx = -1;
     ret.target = map;
+    ret.seen_count = map->count;
+    while (ret.start < map->capacity && map->hashes[ret.start] != 0) ++ret.start;
     ret.next();
     return ret;
 }
 
 Template void This::Iter::next() {
-    idx = wrapped_add(idx, 1ull);
+    // the element we're on got removed, so look at its slot again.
+    if (target->count < seen_count) {
+        seen_count = target->count;
+    } else {
+        idx = wrapped_add(idx, 1ull);
+    }
+
     for (;;) {
-        if (idx >= target->capacity) {
+        if (idx < target->capacity) {
+            u64 slot = (start + idx) & (target->capacity - 1);
+            if (target->hashes[slot] > 1) {
+                key = &target->keys[slot];
+                item = &target->values[slot];
+                return;
+            }
+        } else if (idx < target->capacity + target->old_capacity) {
+            u64 old_idx = idx - target->capacity;
+            if (target->old_hashes[old_idx] > 1) {
+                key = &target->old_keys[old_idx];
+                item = &target->old_values[old_idx];
+                return;
+            }
+        } else {
             done = true;
             return;
         }
-        if (target->hashes[idx] > 1) {
-            key = &target->keys[idx];
-            item = &target->values[idx];
-            return;
-        }
         ++idx;
     }
 }
@@ -183,4 +361,135 @@ Template void This::Iter::next() {
 #undef Template
 #undef This
 // -----------------------------------------------------------------------------
+#if TEST
+
+// only a handful of distinct hashes between all the keys, so nearly every
+// lookup runs into other keys with the same hash.
+struct TestHashArrayCollidingKey {
+    u64 hash;
+    u64 id;
+};
+
+// equal by contents rather than by pointer, like a string key would be.
+struct TestHashArrayStrKey {
+    u64 hash;
+    cchar* str;
+
+    bool eq(TestHashArrayStrKey* other) { return strcmp(str, other->str) == 0; }
+};
+
+void test_hasharray() {
+    ScratchArena scratch{};
+
+    PreHashArray<TestHashArrayCollidingKey, u64> colliding = PreHashArray<TestHashArrayCollidingKey, u64>::make_with_elems(scratch.arena, 1000);
+    for (u64 i = 0; i < 1000; ++i) {
+        TestHashArrayCollidingKey key = {i % 4, i};
+        *colliding.entry(&key) = i * 10;
+    }
+    Assert(colliding.count == 1000);
+    for (u64 i = 0; i < 1000; ++i) {
+        TestHashArrayCollidingKey key = {i % 4, i};
+        u64* value = colliding.maybe_get(&key);
+        AssertM(value && *value == i * 10, "wrong value for colliding key %llu", i);
+    }
+    for (u64 i = 0; i < 1000; i += 2) {
+        TestHashArrayCollidingKey key = {i % 4, i};
+        Assert(colliding.remove(&key));
+    }
+    for (u64 i = 0; i < 1000; ++i) {
+        TestHashArrayCollidingKey key = {i % 4, i};
+        u64* value = colliding.maybe_get(&key);
+        bool kept = i & 1;
+        AssertM(kept ? value && *value == i * 10 : !value, "removing colliding key %llu went wrong", i);
+    }
+    TestHashArrayCollidingKey missing = {1, 5000};
+    Assert(!colliding.maybe_get(&missing));
+
+    char buffers[2][8] = {"apple", "apple"};
+    PreHashArray<TestHashArrayStrKey, u32> strs = PreHashArray<TestHashArrayStrKey, u32>::make_with_elems(scratch.arena, 16);
+    TestHashArrayStrKey apple = {7, buffers[0]};
+    TestHashArrayStrKey apple_copy = {7, buffers[1]};
+    TestHashArrayStrKey pear = {7, "pear"};
+    *strs.entry(&apple) = 1;
+    *strs.entry(&pear) = 2;
+    Assert(*strs.get(&apple_copy) == 1 && *strs.get(&pear) == 2 && strs.count == 2);
+
+    HashArray<u64, u64> plain = HashArray<u64, u64>::make_with_elems(scratch.arena, 1000);
+    for (u64 i = 0; i < 1000; ++i) {
+        *plain.insert(&i) = i + 1;
+    }
+    for (u64 i = 0; i < 1000; ++i) {
+        Assert(*plain.get(&i) == i + 1);
+    }
+
+    // with verification off, equal hashes are taken to mean equal keys.
+    UniquePreHashArray<TestHashArrayCollidingKey, u64> unique = UniquePreHashArray<TestHashArrayCollidingKey, u64>::make_with_elems(scratch.arena, 16);
+    TestHashArrayCollidingKey a = {42, 1}, b = {42, 2};
+    *unique.entry(&a) = 1;
+    Assert(*unique.get(&b) == 1);
+
+    // growing from 16 slots, with lookups and removes landing mid-migration.
+    HashArray<u64, u64> growable = HashArray<u64, u64>::make_growable(scratch.arena, 16);
+    for (u64 i = 0; i < 100000; ++i) {
+        *growable.entry(&i) = i;
+        u64 prev = i / 2;
+        AssertM(prev % 3 == 0 || growable.maybe_get(&prev), "lost key %llu while growing", prev);
+        if (i % 3 == 0) Assert(growable.remove(&i));
+    }
+    for (u64 i = 0; i < 100000; i += 2) {
+        *growable.entry(&i) += 1;
+    }
+    u64 iterated = 0;
+    foreach (it, growable.iter()) {
+        u64 k = *it.key;
+        AssertM(k % 3 != 0 || k % 2 == 0, "removed key %llu is still there", k);
+        AssertM(*it.item == (k % 2 == 0 ? (k % 3 == 0 ? 1 : k + 1) : k), "wrong value for key %llu", k);
+        iterated++;
+    }
+    Assert(iterated == growable.count && growable.capacity > 100000);
+
+    // insert/remove churn at a steady count keeps probes as short as a fresh
+    // map with the same keys would have them.
+    HashArray<u64, u64> churn = HashArray<u64, u64>::make_with_cap(scratch.arena, 1024);
+    HashArray<u64, u64> fresh = HashArray<u64, u64>::make_with_cap(scratch.arena, 1024);
+    for (u64 i = 0; i < 600; ++i) {
+        churn.insert(&i);
+    }
+    for (u64 i = 600; i < 200000; ++i) {
+        u64 old_key = i - 600;
+        Assert(churn.remove(&old_key));
+        churn.insert(&i);
+    }
+    for (u64 i = 200000 - 600; i < 200000; ++i) {
+        AssertM(churn.maybe_get(&i), "lost key %llu to churn", i);
+        fresh.insert(&i);
+    }
+
+    Slice<u64> churn_histogram = churn.probe_histogram(scratch.arena, 32);
+    Slice<u64> fresh_histogram = fresh.probe_histogram(scratch.arena, 32);
+    u64 churn_total = 0, churn_dist = 0, fresh_dist = 0;
+    for (u64 i = 0; i < 32; ++i) {
+        churn_total += churn_histogram[i];
+        churn_dist += churn_histogram[i] * i;
+        fresh_dist += fresh_histogram[i] * i;
+    }
+    Assert(churn_total == 600);
+
+    // removing every element as it's visited, with all of them in one probe run.
+    PreHashArray<TestHashArrayCollidingKey, u64> drained = PreHashArray<TestHashArrayCollidingKey, u64>::make_with_elems(scratch.arena, 16);
+    for (u64 i = 0; i < 10; ++i) {
+        TestHashArrayCollidingKey key = {i % 2, i};
+        *drained.insert(&key) = i;
+    }
+    u64 visited = 0;
+    foreach (it, drained.iter()) {
+        Assert(drained.remove(it.key));
+        visited++;
+    }
+    Assert(visited == 10 && drained.count == 0);
+    AssertM(churn_dist == fresh_dist, "churned probe distance %llu vs fresh %llu", churn_dist, fresh_dist);
+}
+
+#endif
+// -----------------------------------------------------------------------------
 }  // namespace a
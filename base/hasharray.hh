@@ -2,16 +2,49 @@
 #include "inc.hh"
 namespace a {
 // -----------------------------------------------------------------------------
-#define Template template <typename K, typename V, bool PREHASHED>
+#define Template template <typename K, typename V, bool PREHASHED, bool VERIFY_KEYS>
+
+// Open addressing hash map over arena memory. Keys are hashed bytewise, unless
+// PREHASHED, in which case they carry their own `u64 hash` member. When hashes
+// match the keys are compared in full, using `bool eq(K* other)` if the key type
+// has one and comparing bytes otherwise, so prehashed keys that hold pointers
+// need an eq. Comparing bytes includes any padding, so struct keys without an
+// eq should be zeroed before they're filled in. VERIFY_KEYS can be turned off
+// to trust the hash alone when keys are prehashed with hashes known to be
+// unique.
+//
+// Maps from make_growable double in size instead of filling up. Growing starts
+// a new table in the arena and moves a few slots of the old one across on each
+// insert, entry or remove, with lookups checking both until it's done, so no
+// single call pays for the whole rehash. Value pointers into a growable map are
+// only good until its next insert, entry or remove.
+//
+// Removal shifts the rest of the probe run back over the removed slot instead
+// of leaving a tombstone, so churn doesn't lengthen probes. That moves other
+// entries in every map, so value pointers are only good until the next remove
+// too. Removing the element an Iter is on is fine, the Iter picks up whatever
+// got shifted into its slot, but removing anything else mid-iteration or doing
+// it on a growable map can skip or repeat elements. probe_histogram counts
+// elements by their distance from their home slot, for keeping an eye on how
+// well a map's keys spread.
 
 Template class HashArray_ {
     konst u32 LOAD_FACTOR_PERCENT = 70;
+    konst u32 MIGRATE_SLOTS_PER_OP = 4;
 
     u64* hashes;
     K* keys;
     V* values;
     V* value_stub;
 
+    Arena* grow_arena;
+    u64* old_hashes;
+    K* old_keys;
+    V* old_values;
+    u64 old_capacity;
+    u64 old_count;
+    u64 migrate_idx;
+
   public:
     u64 capacity;
     u64 max_elems;
@@ -19,6 +52,8 @@ Template class HashArray_ {
 
     class Iter {
         u64 idx;
+        u64 start;
+        u64 seen_count;
         HashArray_* target;
 
       public:
@@ -32,6 +67,7 @@ Template class HashArray_ {
 
     func HashArray_ make_with_cap(Arena* arena, u64 capacity);
     func HashArray_ make_with_elems(Arena* arena, u64 max_elems);
+    func HashArray_ make_growable(Arena* arena, u64 capacity);
 
     V* insert(K* key);
     V* maybe_get(K* key);
@@ -39,21 +75,39 @@ Template class HashArray_ {
     V* entry(K* key);
     bool remove(K* key);
     void clear();
+    Slice<u64> probe_histogram(Arena* out, usize max_len);
 
     Iter iter() { return Iter::make(this); }
 
   private:
     func HashArray_ make(Arena* arena, u64 capacity, u64 max_elems);
+    func u64 hash_key(K* key);
+    func bool keys_equal(K* a, K* b);
+    func u64 find_idx_in(u64* hashes, K* keys, u64 capacity, K* key, u64 hash);
+    func u64 free_idx_in(u64* hashes, u64 capacity, u64 hash);
 
-    u64 find_idx(K* key);
+    func void count_probe_lengths(Slice<u64> histogram, u64* hashes, u64 capacity);
+
+    V* find(K* key);
+    void remove_shift(u64 hole);
+    void grow_if_full();
+    void migrate(u64 slots);
 };
 
 template <typename K, typename V>
-using HashArray = HashArray_<K, V, false>;
+using HashArray = HashArray_<K, V, false, true>;
 
 template <typename K, typename V>
-using PreHashArray = HashArray_<K, V, true>;
+using PreHashArray = HashArray_<K, V, true, true>;
+
+template <typename K, typename V>
+using UniquePreHashArray = HashArray_<K, V, true, false>;
 
 #undef Template
 // -----------------------------------------------------------------------------
+
+#if TEST
+void test_hasharray();
+#endif
+// -----------------------------------------------------------------------------
 }  // namespace a
\ No newline at end of file
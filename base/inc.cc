@@ -1,12 +1,19 @@
 #include "inc.hh"
 
 #include "timing.cc"
+#include "sync.cc"
 #include "array.cc"
 #include "arena.cc"
 #include "string.cc"
 #include "math.cc"
 #include "hasharray.cc"
+#include "swisshash.cc"
+#include "atomichash.cc"
+#include "pool.cc"
 #include "channel.cc"
+#include "queue.cc"
+#include "jobs.cc"
+#include "parallel.cc"
 #include "fs.cc"
 #include "json.cc"
 #include "bindump.cc"
@@ -16,9 +23,6 @@ namespace a {
 void base_global_init() {
     timing_global_init();
     Arena::global_init();
-    local_persist thread_local Arena scratch[2] = {};
-    scratch[0].create(1_gb);
-    scratch[1].create(1_gb);
-    Arena::thread_init(&scratch[0], &scratch[1]);
+    Arena::thread_init_scratch(1_gb);
 }
 }  // namespace a
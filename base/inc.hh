@@ -18,12 +18,15 @@
 #include <mach/mach_time.h>
 #else
 #include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #endif
 
 #include "../../vendor/simde/arm/neon.h"
 
 #include "defs.hh"
 #include "timing.hh"
+#include "sync.hh"
 #include "simd.hh"
 #include "array.hh"
 #include "arena.hh"
@@ -39,7 +42,13 @@ struct StructMemberInfo {
 #include "math.hh"
 #include "hash.hh"
 #include "hasharray.hh"
+#include "swisshash.hh"
+#include "atomichash.hh"
+#include "pool.hh"
 #include "channel.hh"
+#include "queue.hh"
+#include "jobs.hh"
+#include "parallel.hh"
 #include "fs.hh"
 #include "json.hh"
 #include "bindump.hh"
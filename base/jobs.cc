@@ -0,0 +1,295 @@
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+
+konst u32 JOB_POOL_INJECT_CAPACITY = 4096;
+konst u32 JOB_POOL_IDLE_SPINS = 256;
+
+global thread_local JobWorker* g_job_worker;
+
+// -----------------------------------------------------------------------------
+
+bool JobDeque::push(Job* job) {
+    i64 b = ::std::atomic_load_explicit(bottom.ptr(), ::std::memory_order_relaxed);
+    i64 t = ::std::atomic_load_explicit(top.ptr(), ::std::memory_order_acquire);
+    if (b - t >= CAPACITY) return false;
+
+    ::std::atomic_store_explicit(jobs[b & (CAPACITY - 1)].ptr(), job, ::std::memory_order_relaxed);
+    ::std::atomic_thread_fence(::std::memory_order_release);
+    ::std::atomic_store_explicit(bottom.ptr(), b + 1, ::std::memory_order_relaxed);
+    return true;
+}
+
+Job* JobDeque::pop() {
+    i64 b = ::std::atomic_load_explicit(bottom.ptr(), ::std::memory_order_relaxed) - 1;
+    ::std::atomic_store_explicit(bottom.ptr(), b, ::std::memory_order_relaxed);
+    ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+    i64 t = ::std::atomic_load_explicit(top.ptr(), ::std::memory_order_relaxed);
+
+    if (t > b) {
+        ::std::atomic_store_explicit(bottom.ptr(), b + 1, ::std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = ::std::atomic_load_explicit(jobs[b & (CAPACITY - 1)].ptr(), ::std::memory_order_relaxed);
+    if (t == b) {
+        // last job left, so race any thieves for it.
+        if (!::std::atomic_compare_exchange_strong_explicit(top.ptr(), &t, t + 1, ::std::memory_order_seq_cst, ::std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        ::std::atomic_store_explicit(bottom.ptr(), b + 1, ::std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobDeque::steal() {
+    i64 t = ::std::atomic_load_explicit(top.ptr(), ::std::memory_order_acquire);
+    ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+    i64 b = ::std::atomic_load_explicit(bottom.ptr(), ::std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    Job* job = ::std::atomic_load_explicit(jobs[t & (CAPACITY - 1)].ptr(), ::std::memory_order_relaxed);
+    if (!::std::atomic_compare_exchange_strong_explicit(top.ptr(), &t, t + 1, ::std::memory_order_seq_cst, ::std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+// -----------------------------------------------------------------------------
+
+void JobPool::create(u32 worker_count, usize scratch_size) {
+    ZeroStruct(this);
+
+    if (worker_count == 0) {
+        worker_count = (u32)max(1l, sysconf(_SC_NPROCESSORS_ONLN) - 1);
+    }
+    this->scratch_size = scratch_size;
+
+    // every deque and the injection queue can be full at once, and each thread
+    // can be running jobs on top of that, so the job pool has to cover all of
+    // it or a burst of submits would run it out. the reservation is only
+    // committed as far as it's used.
+    u32 max_jobs = (u32)JobDeque::CAPACITY * (worker_count + 1) + JOB_POOL_INJECT_CAPACITY;
+    usize per_worker_size = sizeof(JobWorker) + JobDeque::CAPACITY * sizeof(AtomicVal<Job*>);
+    arena.create(max_jobs * 2 * sizeof(Job) + JOB_POOL_INJECT_CAPACITY * 2 * sizeof(Job*) + worker_count * per_worker_size + 1_mb);
+    jobs = Pool<Job>::make(&arena, max_jobs);
+    injected = Queue<Job*>::make(&arena, JOB_POOL_INJECT_CAPACITY);
+    workers = arena.push_many<JobWorker>(worker_count);
+
+    for (u32 i = 0; i < worker_count; ++i) {
+        JobWorker* worker = &workers.elems[i];
+        worker->pool = this;
+        worker->idx = i;
+        worker->rng = 0x9e3779b97f4a7c15ull * (i + 1);
+        worker->deque.jobs = arena.push_many<AtomicVal<Job*>>(JobDeque::CAPACITY).elems;
+    }
+    for (u32 i = 0; i < worker_count; ++i) {
+        pthread_create(&workers.elems[i].thread, NULL, worker_main, &workers.elems[i]);
+    }
+}
+
+void JobPool::destroy() {
+    ::std::atomic_store_explicit(shutting_down.ptr(), 1, ::std::memory_order_seq_cst);
+    ::std::atomic_fetch_add_explicit(wake_epoch.ptr(), 1, ::std::memory_order_seq_cst);
+    futex_wake_all(&wake_epoch);
+
+    foreach (it, workers.iter()) {
+        pthread_join(it.item->thread, NULL);
+    }
+
+    arena.destroy();
+    ZeroStruct(this);
+}
+
+void JobPool::submit(JobCounter* counter, JobFn fn, void* data, u64 arg) {
+    ::std::atomic_fetch_add_explicit(counter->pending.ptr(), 1, ::std::memory_order_relaxed);
+
+    PoolHandle handle = jobs.alloc();
+    Job* job = jobs.get(handle);
+    *job = Job{fn, data, arg, counter, handle};
+
+    JobWorker* self = current_worker();
+    bool queued = self ? self->deque.push(job) : injected.try_push(&job);
+    if (!queued) {
+        // everything's backed up anyway, so doing it now loses nothing.
+        run_job(job);
+        return;
+    }
+
+    wake_one();
+}
+
+void JobPool::wait(JobCounter* counter) {
+    JobWorker* self = current_worker();
+    while (::std::atomic_load_explicit(counter->pending.ptr(), ::std::memory_order_acquire) > 0) {
+        Job* job = find_job(self);
+        if (job) {
+            run_job(job);
+        } else {
+            cpu_relax();
+        }
+    }
+}
+
+JobWorker* JobPool::current_worker() {
+    return g_job_worker && g_job_worker->pool == this ? g_job_worker : nullptr;
+}
+
+Job* JobPool::find_job(JobWorker* self) {
+    Job* job = nullptr;
+    if (self && (job = self->deque.pop())) return job;
+    if (injected.try_pop(&job)) return job;
+
+    // start from a random victim so thieves spread out.
+    u64 start = 0;
+    if (self) {
+        self->rng ^= self->rng << 13;
+        self->rng ^= self->rng >> 7;
+        self->rng ^= self->rng << 17;
+        start = self->rng;
+    }
+    for (usize i = 0; i < workers.count; ++i) {
+        JobWorker* victim = &workers.elems[(start + i) % workers.count];
+        if (victim == self) continue;
+        if ((job = victim->deque.steal())) return job;
+    }
+    return nullptr;
+}
+
+void JobPool::run_job(Job* job) {
+    Job copy = *job;
+    jobs.free(copy.handle);
+
+    copy.fn(copy.data, copy.arg);
+    ::std::atomic_fetch_sub_explicit(copy.counter->pending.ptr(), 1, ::std::memory_order_release);
+}
+
+// the fence orders the job being published before the check for sleepers,
+// against a worker announcing itself as a sleeper before its last look for
+// work, so one of them always sees the other.
+void JobPool::wake_one() {
+    ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+    if (::std::atomic_load_explicit(sleepers.ptr(), ::std::memory_order_relaxed) > 0) {
+        ::std::atomic_fetch_add_explicit(wake_epoch.ptr(), 1, ::std::memory_order_relaxed);
+        futex_wake_one(&wake_epoch);
+    }
+}
+
+void JobPool::worker_loop(JobWorker* self) {
+    u32 idle_spins = 0;
+    while (!::std::atomic_load_explicit(shutting_down.ptr(), ::std::memory_order_relaxed)) {
+        Job* job = find_job(self);
+        if (job) {
+            run_job(job);
+            idle_spins = 0;
+            continue;
+        }
+
+        if (++idle_spins < JOB_POOL_IDLE_SPINS) {
+            cpu_relax();
+            continue;
+        }
+
+        ::std::atomic_fetch_add_explicit(sleepers.ptr(), 1, ::std::memory_order_seq_cst);
+        u32 epoch = ::std::atomic_load_explicit(wake_epoch.ptr(), ::std::memory_order_seq_cst);
+        job = find_job(self);
+        if (job) {
+            ::std::atomic_fetch_sub_explicit(sleepers.ptr(), 1, ::std::memory_order_relaxed);
+            run_job(job);
+            idle_spins = 0;
+            continue;
+        }
+        if (!::std::atomic_load_explicit(shutting_down.ptr(), ::std::memory_order_seq_cst)) {
+            futex_wait(&wake_epoch, epoch);
+        }
+        ::std::atomic_fetch_sub_explicit(sleepers.ptr(), 1, ::std::memory_order_relaxed);
+    }
+}
+
+void* JobPool::worker_main(void* arg) {
+    JobWorker* self = (JobWorker*)arg;
+    g_job_worker = self;
+    Arena::thread_init_scratch(self->pool->scratch_size);
+    self->pool->worker_loop(self);
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+forall(Fn) void JobPool::run_chunks(usize chunk_count, Fn fn) {
+    if (chunk_count == 0) return;
+
+    JobCounter counter = {};
+    for (usize i = 1; i < chunk_count; ++i) {
+        submit(&counter, run_chunk<Fn>, &fn, i);
+    }
+    fn((usize)0);
+    wait(&counter);
+}
+
+forall(Fn) void JobPool::run_chunk(void* data, u64 chunk) {
+    (*(Fn*)data)((usize)chunk);
+}
+
+// -----------------------------------------------------------------------------
+#if TEST
+#define WORKER_COUNT 4
+#define NUM_ITEMS 1000000
+
+struct TestJobsTree {
+    JobPool* pool;
+    u64 depth;
+    AtomicVal<u64>* leaves;
+};
+
+// every level submits two children and waits on them, so waits have to help
+// out for this to finish without more threads than levels.
+void test_jobs_tree(void* data, u64 depth) {
+    TestJobsTree* tree = (TestJobsTree*)data;
+    if (depth == tree->depth) {
+        ScratchArena scratch{};
+        *scratch.arena->push<u64>() = depth;
+        ::std::atomic_fetch_add_explicit(tree->leaves->ptr(), 1, ::std::memory_order_relaxed);
+        return;
+    }
+
+    JobCounter counter = {};
+    tree->pool->submit(&counter, test_jobs_tree, data, depth + 1);
+    tree->pool->submit(&counter, test_jobs_tree, data, depth + 1);
+    tree->pool->wait(&counter);
+}
+
+void test_jobs() {
+    ScratchArena scratch{};
+
+    JobPool pool;
+    pool.create(WORKER_COUNT, 1_mb);
+
+    Slice<u64> items = scratch.arena->push_many<u64>(NUM_ITEMS);
+    for (usize chunk_size = 1000; chunk_size <= NUM_ITEMS; chunk_size *= 10) {
+        pool.run_chunks((NUM_ITEMS + chunk_size - 1) / chunk_size, [&](usize chunk) {
+            usize end = min((chunk + 1) * chunk_size, (usize)NUM_ITEMS);
+            for (usize i = chunk * chunk_size; i < end; ++i) {
+                items.elems[i] += 1;
+            }
+        });
+    }
+    foreach (it, items.iter()) {
+        Assert(*it.item == 4);
+    }
+
+    AtomicVal<u64> leaves = {};
+    TestJobsTree tree = {&pool, 12, &leaves};
+    JobCounter counter = {};
+    pool.submit(&counter, test_jobs_tree, &tree, 0);
+    pool.wait(&counter);
+    AssertM(*leaves == 1ull << tree.depth, "expected %llu leaves but got %llu", 1ull << tree.depth, (u64)*leaves);
+
+    pool.destroy();
+}
+
+#undef WORKER_COUNT
+#undef NUM_ITEMS
+#endif
+// -----------------------------------------------------------------------------
+}  // namespace a
@@ -0,0 +1,100 @@
+#pragma once
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+
+// Work-stealing job system
+//
+// A fixed set of worker threads, each with its own deque of jobs. Jobs
+// submitted from a worker go on its own deque, which it works through newest
+// first while idle workers steal the oldest jobs off the other end. Jobs
+// submitted from any other thread go through a shared injection queue. Every
+// worker gets its own scratch arenas, so ScratchArena works inside jobs.
+//
+// Waiting on a JobCounter runs other jobs in the meantime instead of blocking,
+// so jobs can submit and wait on jobs of their own.
+
+typedef void (*JobFn)(void* data, u64 arg);
+
+struct JobCounter {
+    AtomicVal<u32> pending;
+};
+
+struct Job {
+    JobFn fn;
+    void* data;
+    u64 arg;
+    JobCounter* counter;
+    PoolHandle handle;
+};
+
+// Chase-Lev deque. Only the owning worker pushes and pops at the bottom, any
+// thread can steal from the top.
+struct JobDeque {
+    konst i64 CAPACITY = 4096;
+
+    alignas(CACHE_LINE_SIZE) AtomicVal<i64> top;
+    alignas(CACHE_LINE_SIZE) AtomicVal<i64> bottom;
+    AtomicVal<Job*>* jobs;
+
+    bool push(Job* job);
+    Job* pop();
+    Job* steal();
+};
+
+class JobPool;
+
+struct JobWorker {
+    JobPool* pool;
+    u32 idx;
+    u64 rng;
+    pthread_t thread;
+    JobDeque deque;
+};
+
+class JobPool {
+    Arena arena;
+    Pool<Job> jobs;
+    Queue<Job*> injected;
+    Slice<JobWorker> workers;
+    usize scratch_size;
+    AtomicVal<u32> shutting_down;
+
+    alignas(CACHE_LINE_SIZE) AtomicVal<u32> wake_epoch;
+    AtomicVal<u32> sleepers;
+
+  public:
+    // worker_count of 0 means one per core besides the calling thread, and
+    // scratch_size of 0 means Arena's default per-thread scratch size.
+    void create(u32 worker_count = 0, usize scratch_size = 0);
+    void destroy();
+
+    u32 worker_count() { return (u32)workers.count; }
+
+    // counter->pending is incremented here and decremented once the job has run.
+    void submit(JobCounter* counter, JobFn fn, void* data, u64 arg = 0);
+    void wait(JobCounter* counter);
+
+    // calls fn(usize chunk) for every chunk below chunk_count, spread across
+    // the workers and the calling thread, and returns once they've all run.
+    forall(Fn) void run_chunks(usize chunk_count, Fn fn);
+
+  private:
+    JobWorker* current_worker();
+    Job* find_job(JobWorker* self);
+    void run_job(Job* job);
+    void wake_one();
+    void worker_loop(JobWorker* self);
+
+    func void* worker_main(void* arg);
+    forall(Fn) func void run_chunk(void* data, u64 chunk);
+};
+
+// -----------------------------------------------------------------------------
+
+#if TEST
+void test_jobs();
+#endif
+
+// -----------------------------------------------------------------------------
+}  // namespace a
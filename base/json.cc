@@ -332,7 +332,7 @@ forall(T) bool json_deserialize(Arena* arena, void* ctx, cchar* end, cchar** rea
     for (;;) {
         if (json_expect(end, read, "]")) break;
 
-        T* elem = val->push();
+        T* elem = val->push(arena);
         if (!json_deserialize(arena, ctx, end, read, elem)) goto fail;
 
         json_chomp_whitespace(end, read);
@@ -391,7 +391,7 @@ forall(T) bool json_deserialize(Arena* arena, void* ctx, cchar* end, cchar** rea
         if (!json_expect_immediate(end, read, ",")) goto fail;
     }
 
-    *val = arena->push_many<T>(elems);
+    *val = arena->push_many_uninit<T>(elems);
     ArrayCopy(val->elems, first_elem, elems);
 
     return true;
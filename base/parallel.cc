@@ -0,0 +1,140 @@
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+
+ParallelChunks ParallelChunks::make(void* elems, usize elem_size, usize count, usize thread_count) {
+    ParallelChunks ret = {};
+    ret.count = count;
+
+    // elements that don't tile a cache line can't be split on line boundaries,
+    // in which case at most the boundary lines get shared.
+    usize line_elems = 1;
+    usize misalign = (usize)elems % CACHE_LINE_SIZE;
+    if (CACHE_LINE_SIZE % elem_size == 0 && misalign % elem_size == 0) {
+        line_elems = CACHE_LINE_SIZE / elem_size;
+        ret.lead = min(count, (CACHE_LINE_SIZE - misalign) % CACHE_LINE_SIZE / elem_size);
+    }
+
+    // a few chunks per thread so stealing can even out uneven work.
+    usize target = count / (4 * thread_count);
+    ret.chunk_size = max(line_elems, (target + line_elems - 1) / line_elems * line_elems);
+
+    usize first_end = ret.lead + ret.chunk_size;
+    ret.chunk_count = count <= first_end ? 1 : 1 + (count - first_end + ret.chunk_size - 1) / ret.chunk_size;
+    if (count == 0) ret.chunk_count = 0;
+    return ret;
+}
+
+forall(T, Fn) void parallel_for(JobPool* pool, Slice<T> items, Fn fn) {
+    ParallelChunks chunks = ParallelChunks::make(items.elems, sizeof(T), items.count, pool->worker_count() + 1);
+    pool->run_chunks(chunks.chunk_count, [&](usize chunk) {
+        usize end = chunks.end(chunk);
+        for (usize i = chunks.start(chunk); i < end; ++i) {
+            fn(&items.elems[i]);
+        }
+    });
+}
+
+forall(T, Fn) auto parallel_map(JobPool* pool, Arena* out, Slice<T> items, Fn fn) -> Slice<decltype(fn(items.elems))> {
+    using U = decltype(fn(items.elems));
+
+    out->align<CacheAligned<U>>();
+    Slice<U> results = out->push_many_uninit<U>(items.count);
+
+    ParallelChunks chunks = ParallelChunks::make(results.elems, sizeof(U), items.count, pool->worker_count() + 1);
+    pool->run_chunks(chunks.chunk_count, [&](usize chunk) {
+        usize end = chunks.end(chunk);
+        for (usize i = chunks.start(chunk); i < end; ++i) {
+            results.elems[i] = fn(&items.elems[i]);
+        }
+    });
+    return results;
+}
+
+forall(T, U, Fold, Combine) U parallel_reduce(JobPool* pool, Slice<T> items, U identity, Fold fold, Combine combine) {
+    ScratchArena scratch{};
+
+    // nothing is written to items, but lining chunks up with its cache lines
+    // still keeps every line read by just one thread.
+    ParallelChunks chunks = ParallelChunks::make(items.elems, sizeof(T), items.count, pool->worker_count() + 1);
+    Slice<CacheAligned<U>> partials = scratch.arena->push_many_uninit<CacheAligned<U>>(chunks.chunk_count);
+
+    pool->run_chunks(chunks.chunk_count, [&](usize chunk) {
+        U acc = identity;
+        usize end = chunks.end(chunk);
+        for (usize i = chunks.start(chunk); i < end; ++i) {
+            acc = fold(acc, &items.elems[i]);
+        }
+        partials.elems[chunk].val = acc;
+    });
+
+    U ret = identity;
+    foreach (it, partials.iter()) {
+        ret = combine(ret, it.item->val);
+    }
+    return ret;
+}
+
+// -----------------------------------------------------------------------------
+#if TEST
+#define NUM_ITEMS 1000003
+
+void test_parallel() {
+    ScratchArena scratch{};
+
+    JobPool pool;
+    pool.create(4, 1_mb);
+
+    // chunks start off the array's first line boundary and end on later ones.
+    for (usize offset = 0; offset < 8; ++offset) {
+        u64* elems = scratch.arena->push_many<u64>(64 + offset).elems + offset;
+        ParallelChunks chunks = ParallelChunks::make(elems, sizeof(u64), 64, 4);
+        Assert(chunks.start(0) == 0 && chunks.end(chunks.chunk_count - 1) == 64);
+        for (usize i = 1; i < chunks.chunk_count; ++i) {
+            Assert(chunks.start(i) == chunks.end(i - 1));
+            AssertM((usize)&elems[chunks.start(i)] % CACHE_LINE_SIZE == 0, "chunk %zu doesn't start on a cache line", i);
+        }
+    }
+
+    Vec<u32> vec = Vec<u32>::make(scratch.arena, NUM_ITEMS);
+    for (u32 i = 0; i < NUM_ITEMS; ++i) {
+        *vec.push() = i;
+    }
+
+    parallel_for(&pool, &vec, [](u32* item) { *item *= 2; });
+
+    // offset by one so the input doesn't start on a line boundary.
+    Slice<u32> tail = {vec.elems + 1, vec.count - 1};
+    Slice<u64> squares = parallel_map(&pool, scratch.arena, tail, [](u32* item) { return (u64)*item * *item; });
+    AssertM((usize)squares.elems % CACHE_LINE_SIZE == 0, "parallel_map results aren't cache line aligned");
+    for (usize i = 0; i < squares.count; ++i) {
+        Assert(squares.elems[i] == 4 * (u64)(i + 1) * (i + 1));
+    }
+
+    u64 sum = parallel_reduce(&pool, tail, (u64)0, [](u64 acc, u32* item) { return acc + *item; }, [](u64 a, u64 b) { return a + b; });
+    AssertM(sum == (u64)NUM_ITEMS * (NUM_ITEMS - 1), "expected %llu but got %llu", (u64)NUM_ITEMS * (NUM_ITEMS - 1), sum);
+
+    // combining in chunk order keeps non-commutative reductions intact.
+    Array<u32, 4096> indices = {};
+    for (u32 i = 0; i < 4096; ++i) indices.elems[i] = i;
+    Pair<u32, u32> range = parallel_reduce(
+        &pool, &indices, Pair<u32, u32>{UINT32_MAX, UINT32_MAX},
+        [](Pair<u32, u32> acc, u32* item) {
+            Assert(acc.left == UINT32_MAX || acc.right + 1 == *item);
+            return Pair<u32, u32>{acc.left == UINT32_MAX ? *item : acc.left, *item};
+        },
+        [](Pair<u32, u32> a, Pair<u32, u32> b) {
+            if (a.left == UINT32_MAX) return b;
+            Assert(b.left == UINT32_MAX || a.right + 1 == b.left);
+            return b.left == UINT32_MAX ? a : Pair<u32, u32>{a.left, b.right};
+        }
+    );
+    Assert(range.left == 0 && range.right == 4095);
+
+    pool.destroy();
+}
+
+#undef NUM_ITEMS
+#endif
+// -----------------------------------------------------------------------------
+}  // namespace a
@@ -0,0 +1,50 @@
+#pragma once
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+
+// Parallel iteration over arrays
+//
+// These split the items into chunks that run across a JobPool, with the calling
+// thread taking chunks too. Chunk boundaries land on cache line boundaries of
+// the array being written to, so no two threads ever write to the same line.
+// The Vec and Array overloads just run over their slice.
+
+// How a run of count elements gets divided up. The first chunk also takes the
+// lead elements before the first cache line boundary.
+struct ParallelChunks {
+    usize count;
+    usize lead;
+    usize chunk_size;
+    usize chunk_count;
+
+    func ParallelChunks make(void* elems, usize elem_size, usize count, usize thread_count);
+
+    usize start(usize chunk) { return chunk == 0 ? 0 : min(count, lead + chunk * chunk_size); }
+    usize end(usize chunk) { return min(count, lead + (chunk + 1) * chunk_size); }
+};
+
+// calls fn(T* item) for every item.
+forall(T, Fn) void parallel_for(JobPool* pool, Slice<T> items, Fn fn);
+forall(C, Fn) void parallel_for(JobPool* pool, C* items, Fn fn) { parallel_for(pool, items->slice(), fn); }
+
+// returns fn(T* item) for every item, in an array allocated from out.
+forall(T, Fn) auto parallel_map(JobPool* pool, Arena* out, Slice<T> items, Fn fn) -> Slice<decltype(fn(items.elems))>;
+forall(C, Fn) auto parallel_map(JobPool* pool, Arena* out, C* items, Fn fn) { return parallel_map(pool, out, items->slice(), fn); }
+
+// folds each chunk with fold(U acc, T* item) starting from identity, then
+// merges the chunks' results in order with combine(U a, U b). combine only
+// needs to be associative, not commutative.
+forall(T, U, Fold, Combine) U parallel_reduce(JobPool* pool, Slice<T> items, U identity, Fold fold, Combine combine);
+forall(C, U, Fold, Combine) U parallel_reduce(JobPool* pool, C* items, U identity, Fold fold, Combine combine) {
+    return parallel_reduce(pool, items->slice(), identity, fold, combine);
+}
+
+// -----------------------------------------------------------------------------
+
+#if TEST
+void test_parallel();
+#endif
+
+// -----------------------------------------------------------------------------
+}  // namespace a
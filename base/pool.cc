@@ -0,0 +1,254 @@
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+#define This Pool<T>
+
+forall(T) This This::make(Arena* arena, u32 capacity) {
+    This ret = {};
+    ret.slots = arena->push_many<Slot>(capacity).elems;
+    ret.capacity = capacity;
+    return ret;
+}
+
+forall(T) PoolHandle This::alloc() {
+    u32 idx = pop_free();
+    if (idx == UINT32_MAX) {
+        u32 claimed;
+        idx = claim_fresh(1, &claimed);
+    }
+    return activate(idx);
+}
+
+forall(T) bool This::free(PoolHandle handle) {
+    if (!deactivate(handle)) return false;
+    push_free(Slice<u32>{&handle.idx, 1});
+    return true;
+}
+
+forall(T) T* This::get(PoolHandle handle) {
+    if (handle.idx >= capacity) return nullptr;
+    Slot* slot = &slots[handle.idx];
+    u32 gen = ::std::atomic_load_explicit(slot->gen.ptr(), ::std::memory_order_acquire);
+    return gen == handle.gen && (handle.gen & 1) ? &slot->item : nullptr;
+}
+
+// returns the first of up to count never used slots, fewer if the pool is nearly full.
+forall(T) u32 This::claim_fresh(u32 count, u32* claimed) {
+    u32 idx = ::std::atomic_fetch_add_explicit(used.ptr(), count, ::std::memory_order_relaxed);
+    AssertM(idx < capacity, "pool is full");
+    *claimed = min(count, capacity - idx);
+    return idx;
+}
+
+forall(T) u32 This::pop_free() {
+    u64 head = ::std::atomic_load_explicit(free_head.ptr(), ::std::memory_order_acquire);
+    for (;;) {
+        u32 top = (u32)head;
+        if (top == 0) return UINT32_MAX;
+
+        // the tag bump makes the exchange fail if the slot was popped and pushed
+        // back in the meantime, even though its index would match.
+        u32 next = ::std::atomic_load_explicit(slots[top - 1].next_free.ptr(), ::std::memory_order_relaxed);
+        u64 new_head = ((head >> 32) + 1) << 32 | next;
+        if (::std::atomic_compare_exchange_weak_explicit(free_head.ptr(), &head, new_head, ::std::memory_order_acquire, ::std::memory_order_acquire)) {
+            return top - 1;
+        }
+    }
+}
+
+// links the batch together locally so it goes onto the list with one exchange.
+forall(T) void This::push_free(Slice<u32> idxs) {
+    if (idxs.count == 0) return;
+    for (usize i = 0; i + 1 < idxs.count; ++i) {
+        ::std::atomic_store_explicit(slots[idxs.elems[i]].next_free.ptr(), idxs.elems[i + 1] + 1, ::std::memory_order_relaxed);
+    }
+    AtomicVal<u32>* last_next = &slots[idxs.elems[idxs.count - 1]].next_free;
+
+    u64 head = ::std::atomic_load_explicit(free_head.ptr(), ::std::memory_order_relaxed);
+    for (;;) {
+        ::std::atomic_store_explicit(last_next->ptr(), (u32)head, ::std::memory_order_relaxed);
+        u64 new_head = ((head >> 32) + 1) << 32 | (idxs.elems[0] + 1);
+        if (::std::atomic_compare_exchange_weak_explicit(free_head.ptr(), &head, new_head, ::std::memory_order_release, ::std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+forall(T) PoolHandle This::activate(u32 idx) {
+    Slot* slot = &slots[idx];
+    ZeroStruct(&slot->item);
+
+    // the slot is off the free list, so nothing else writes gen until it's freed.
+    u32 gen = ::std::atomic_load_explicit(slot->gen.ptr(), ::std::memory_order_relaxed) + 1;
+    ::std::atomic_store_explicit(slot->gen.ptr(), gen, ::std::memory_order_release);
+    return PoolHandle{idx, gen};
+}
+
+// only one of any number of racing frees of the same handle wins the exchange,
+// so a slot can't end up on the free list twice.
+forall(T) bool This::deactivate(PoolHandle handle) {
+    if (handle.idx >= capacity || !(handle.gen & 1)) return false;
+    u32 gen = handle.gen;
+    return ::std::atomic_compare_exchange_strong_explicit(slots[handle.idx].gen.ptr(), &gen, handle.gen + 1, ::std::memory_order_acq_rel, ::std::memory_order_relaxed);
+}
+
+#undef This
+// -----------------------------------------------------------------------------
+#define This PoolCache<T>
+
+forall(T) This This::make(Pool<T>* pool) {
+    This ret = {};
+    ret.pool = pool;
+    return ret;
+}
+
+forall(T) PoolHandle This::alloc() {
+    if (idxs.count == 0) {
+        while (idxs.count < CAPACITY / 2) {
+            u32 idx = pool->pop_free();
+            if (idx == UINT32_MAX) break;
+            *idxs.push() = idx;
+        }
+    }
+    if (idxs.count == 0) {
+        u32 claimed = 0;
+        u32 first = pool->claim_fresh(CAPACITY / 2, &claimed);
+        for (u32 i = claimed; i > 0; --i) {
+            *idxs.push() = first + i - 1;
+        }
+    }
+    return pool->activate(*idxs.pop());
+}
+
+forall(T) bool This::free(PoolHandle handle) {
+    if (!pool->deactivate(handle)) return false;
+    if (idxs.count == CAPACITY) {
+        pool->push_free(Slice<u32>{idxs.elems + CAPACITY / 2, CAPACITY / 2});
+        idxs.count = CAPACITY / 2;
+    }
+    *idxs.push() = handle.idx;
+    return true;
+}
+
+forall(T) void This::flush() {
+    pool->push_free(idxs.slice());
+    idxs.count = 0;
+}
+
+#undef This
+// -----------------------------------------------------------------------------
+#if TEST
+#define THREAD_COUNT 8
+#define NUM_OPS 50000
+#define LIVE_PER_THREAD 100
+
+struct TestPoolItem {
+    u64 owner;
+    u64 value;
+};
+
+struct TestPoolArgs {
+    Pool<TestPoolItem>* pool;
+    u64 owner;
+};
+
+void* test_pool_thread(void* arg) {
+    TestPoolArgs* args = (TestPoolArgs*)arg;
+    Pool<TestPoolItem>* pool = args->pool;
+    u64 owner = args->owner;
+
+    PoolCache<TestPoolItem> cache = PoolCache<TestPoolItem>::make(pool);
+    PoolHandle live[LIVE_PER_THREAD] = {};
+
+    for (u64 i = 0; i < NUM_OPS; ++i) {
+        u64 slot = (i * 7919) % LIVE_PER_THREAD;
+        if (live[slot].gen) {
+            TestPoolItem* item = cache.get(live[slot]);
+            Assert(item && item->owner == owner && item->value == slot);
+            PoolHandle stale = live[slot];
+            bool freed = i & 1 ? cache.free(live[slot]) : pool->free(live[slot]);
+            Assert(freed);
+            Assert(!pool->get(stale));
+            Assert(!pool->free(stale));
+            live[slot] = {};
+        } else {
+            live[slot] = i % 3 ? cache.alloc() : pool->alloc();
+            TestPoolItem* item = pool->get(live[slot]);
+            Assert(item->owner == 0 && item->value == 0);
+            item->owner = owner;
+            item->value = slot;
+        }
+    }
+
+    cache.flush();
+    return nullptr;
+}
+
+struct TestPoolDoubleFreeArgs {
+    Pool<TestPoolItem>* pool;
+    PoolHandle* handles;
+    u32 count;
+    AtomicVal<u32>* freed;
+};
+
+// every thread frees every handle, and only one free of each should win.
+void* test_pool_double_free_thread(void* arg) {
+    TestPoolDoubleFreeArgs* args = (TestPoolDoubleFreeArgs*)arg;
+    for (u32 i = 0; i < args->count; ++i) {
+        if (args->pool->free(args->handles[i])) {
+            ::std::atomic_fetch_add_explicit(args->freed->ptr(), 1, ::std::memory_order_relaxed);
+        }
+        if (i % 64 == 0) sched_yield();
+    }
+    return nullptr;
+}
+
+void test_pool() {
+    ScratchArena scratch{};
+
+    // with every thread holding at most LIVE_PER_THREAD items plus a cache,
+    // churning through far more allocs than this only fits if slots are reused.
+    Pool<TestPoolItem> pool = Pool<TestPoolItem>::make(scratch.arena, THREAD_COUNT * (LIVE_PER_THREAD + 128));
+
+    pthread_t threads[THREAD_COUNT];
+    TestPoolArgs args[THREAD_COUNT];
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        args[i] = {&pool, i + 1};
+        pthread_create(&threads[i], NULL, test_pool_thread, &args[i]);
+    }
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    konst u32 DOUBLE_FREE_COUNT = 1000;
+    Pool<TestPoolItem> small = Pool<TestPoolItem>::make(scratch.arena, DOUBLE_FREE_COUNT);
+    PoolHandle handles[DOUBLE_FREE_COUNT];
+    for (u32 i = 0; i < DOUBLE_FREE_COUNT; ++i) {
+        handles[i] = small.alloc();
+    }
+
+    AtomicVal<u32> freed = {};
+    TestPoolDoubleFreeArgs double_free_args = {&small, handles, DOUBLE_FREE_COUNT, &freed};
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        pthread_create(&threads[i], NULL, test_pool_double_free_thread, &double_free_args);
+    }
+    for (u64 i = 0; i < THREAD_COUNT; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    Assert(::std::atomic_load_explicit(freed.ptr(), ::std::memory_order_relaxed) == DOUBLE_FREE_COUNT);
+
+    // a slot pushed onto the free list twice would get handed out twice here.
+    bool seen[DOUBLE_FREE_COUNT] = {};
+    for (u32 i = 0; i < DOUBLE_FREE_COUNT; ++i) {
+        PoolHandle handle = small.alloc();
+        AssertM(!seen[handle.idx], "slot %u handed out twice", handle.idx);
+        seen[handle.idx] = true;
+    }
+}
+
+#undef THREAD_COUNT
+#undef NUM_OPS
+#undef LIVE_PER_THREAD
+#endif
+// -----------------------------------------------------------------------------
+}  // namespace a
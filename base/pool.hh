@@ -0,0 +1,84 @@
+#pragma once
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+
+// Handle to an object in a Pool. The generation makes handles to freed slots
+// detectably stale instead of silently aliasing whatever reused the slot.
+// A zeroed handle is never valid.
+struct PoolHandle {
+    u32 idx;
+    u32 gen;
+};
+
+// Fixed capacity pool of T built on an Arena, with O(1) alloc and free so
+// long-lived objects can come and go without growing the arena. Slots are only
+// touched once they're first handed out, so a generous capacity is cheap.
+//
+// alloc and free are lock-free and can be called from any thread. Freeing a
+// handle while another thread is still using it is on the caller, the same as
+// with any allocator. A PoolCache per thread batches traffic to the shared
+// free list.
+//
+// capacity is a hard cap rather than a starting size: once every slot has been
+// handed out and the shared free list is empty, alloc panics with "pool is
+// full". Free slots sitting in other threads' PoolCaches aren't stolen back,
+// so size the pool for the most objects ever live at once plus
+// PoolCache::CAPACITY for each thread using a cache.
+forall(T) class Pool {
+    struct Slot {
+        T item;
+        AtomicVal<u32> gen;  // odd while the slot is allocated
+        AtomicVal<u32> next_free;
+    };
+
+    Slot* slots;
+    AtomicVal<u64> free_head;  // ABA tag in the high half, slot idx + 1 in the low half
+    AtomicVal<u32> used;
+
+  public:
+    u32 capacity;
+
+    func Pool make(Arena* arena, u32 capacity);
+
+    PoolHandle alloc();
+    bool free(PoolHandle handle);
+    T* get(PoolHandle handle);
+
+  private:
+    u32 claim_fresh(u32 count, u32* claimed);
+    u32 pop_free();
+    void push_free(Slice<u32> idxs);
+    PoolHandle activate(u32 idx);
+    bool deactivate(PoolHandle handle);
+
+    forall(U) friend class PoolCache;
+};
+
+// Per-thread front for a Pool. Allocations and frees go through a small local
+// stack of slot indices and only reach the shared free list in batches.
+forall(T) class PoolCache {
+    konst u32 CAPACITY = 64;
+
+    Pool<T>* pool;
+    InlineVec<u32, CAPACITY> idxs;
+
+  public:
+    func PoolCache make(Pool<T>* pool);
+
+    PoolHandle alloc();
+    bool free(PoolHandle handle);
+    T* get(PoolHandle handle) { return pool->get(handle); }
+
+    // hands every cached slot back to the pool, call before the thread exits.
+    void flush();
+};
+
+// -----------------------------------------------------------------------------
+
+#if TEST
+void test_pool();
+#endif
+
+// -----------------------------------------------------------------------------
+}  // namespace a
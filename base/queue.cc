@@ -0,0 +1,380 @@
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+#define This Queue<T>
+
+forall(T) This This::make(Arena* arena, usize capacity) {
+    usize rounded = 2;
+    while (rounded < capacity) rounded <<= 1;
+
+    This ret{};
+    ret.slots = arena->push_many<Slot>(rounded).elems;
+    ret.mask = rounded - 1;
+    for (u64 i = 0; i < rounded; ++i) {
+        *ret.slots[i].seq = i;
+    }
+    return ret;
+}
+
+forall(T) bool This::try_push(T* item) {
+    return try_push_many(Slice<T>{item, 1}) == 1;
+}
+
+forall(T) bool This::try_pop(T* out) {
+    return try_pop_many(Slice<T>{out, 1}) == 1;
+}
+
+forall(T) usize This::try_push_many(Slice<T> items) {
+    usize count;
+    u64 pos = claim(&push_pos, 0, items.count, &count);
+    for (usize i = 0; i < count; ++i) {
+        Slot* slot = &slots[(pos + i) & mask];
+        slot->item = items.elems[i];
+        ::std::atomic_store_explicit(slot->seq.ptr(), pos + i + 1, ::std::memory_order_release);
+    }
+    return count;
+}
+
+forall(T) usize This::try_pop_many(Slice<T> out) {
+    usize count;
+    u64 pos = claim(&pop_pos, 1, out.count, &count);
+    for (usize i = 0; i < count; ++i) {
+        Slot* slot = &slots[(pos + i) & mask];
+        out.elems[i] = slot->item;
+        ::std::atomic_store_explicit(slot->seq.ptr(), pos + i + mask + 1, ::std::memory_order_release);
+    }
+    return count;
+}
+
+// a slot is ready for position p on one end when its sequence reads p + lap_offset.
+// this takes the run of consecutive ready slots at that end, up to max_count, with
+// a single exchange. nobody else can touch a ready slot until they've claimed it
+// too, so the run can't go stale between checking it and claiming it.
+forall(T) u64 This::claim(AtomicVal<u64>* pos, u64 lap_offset, usize max_count, usize* count) {
+    u64 start = ::std::atomic_load_explicit(pos->ptr(), ::std::memory_order_relaxed);
+    for (;;) {
+        usize ready = 0;
+        while (ready < max_count) {
+            u64 seq = ::std::atomic_load_explicit(slots[(start + ready) & mask].seq.ptr(), ::std::memory_order_acquire);
+            if (seq != start + ready + lap_offset) break;
+            ready++;
+        }
+
+        if (ready == 0) {
+            // either the queue is full/empty or another thread claimed start
+            // since we loaded it, in which case there's more to try.
+            u64 current = ::std::atomic_load_explicit(pos->ptr(), ::std::memory_order_relaxed);
+            if (current == start) {
+                *count = 0;
+                return start;
+            }
+            start = current;
+            continue;
+        }
+
+        if (::std::atomic_compare_exchange_weak_explicit(pos->ptr(), &start, start + ready, ::std::memory_order_relaxed, ::std::memory_order_relaxed)) {
+            *count = ready;
+            return start;
+        }
+    }
+}
+
+#undef This
+// -----------------------------------------------------------------------------
+#define This Ring<T>
+
+forall(T) This This::make(Arena* arena, usize capacity) {
+    usize rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+
+    This ret{};
+    ret.elems = arena->push_many<T>(rounded).elems;
+    ret.mask = rounded - 1;
+    return ret;
+}
+
+forall(T) Slice<T> This::reserve(usize count) {
+    u64 pos = ::std::atomic_load_explicit(write_pos.ptr(), ::std::memory_order_relaxed);
+    u64 free = capacity() - (pos - cached_read_pos);
+    if (free < count) {
+        cached_read_pos = ::std::atomic_load_explicit(read_pos.ptr(), ::std::memory_order_acquire);
+        free = capacity() - (pos - cached_read_pos);
+    }
+
+    u64 contiguous = capacity() - (pos & mask);
+    return Slice<T>{&elems[pos & mask], (usize)min((u64)count, min(free, contiguous))};
+}
+
+forall(T) void This::commit(usize count) {
+    u64 pos = ::std::atomic_load_explicit(write_pos.ptr(), ::std::memory_order_relaxed);
+    DebugAssertM(pos + count - cached_read_pos <= capacity(), "committed more than was reserved");
+    ::std::atomic_store_explicit(write_pos.ptr(), pos + count, ::std::memory_order_release);
+}
+
+forall(T) Slice<T> This::peek() {
+    u64 pos = ::std::atomic_load_explicit(read_pos.ptr(), ::std::memory_order_relaxed);
+    if (cached_write_pos == pos) {
+        cached_write_pos = ::std::atomic_load_explicit(write_pos.ptr(), ::std::memory_order_acquire);
+    }
+
+    u64 contiguous = capacity() - (pos & mask);
+    return Slice<T>{&elems[pos & mask], min(cached_write_pos - pos, contiguous)};
+}
+
+forall(T) void This::release(usize count) {
+    u64 pos = ::std::atomic_load_explicit(read_pos.ptr(), ::std::memory_order_relaxed);
+    DebugAssertM(pos + count <= cached_write_pos, "released more than was peeked");
+    ::std::atomic_store_explicit(read_pos.ptr(), pos + count, ::std::memory_order_release);
+}
+
+#undef This
+// -----------------------------------------------------------------------------
+#if TEST
+#define PRODUCER_COUNT 4
+#define CONSUMER_COUNT 4
+#define NUM_ITEMS 65536
+#define BATCH_SIZE 16
+
+global ::std::atomic_bool test_queue_start;
+global ::std::atomic_uint test_queue_producers_left;
+
+void* test_queue_push_thread(void* arg) {
+    while (!test_queue_start);
+
+    Queue<u64>* queue = (Queue<u64>*)arg;
+    u64 batch[BATCH_SIZE];
+    for (u64 i = 1; i <= NUM_ITEMS;) {
+        usize pushed;
+        if (i % 2) {
+            pushed = queue->try_push(&i) ? 1 : 0;
+        } else {
+            usize count = min((u64)BATCH_SIZE, NUM_ITEMS + 1 - i);
+            for (usize j = 0; j < count; ++j) batch[j] = i + j;
+            pushed = queue->try_push_many(Slice<u64>{batch, count});
+        }
+        if (pushed == 0) sched_yield();
+        i += pushed;
+    }
+
+    test_queue_producers_left--;
+    return nullptr;
+}
+
+void* test_queue_pop_thread(void* arg) {
+    while (!test_queue_start);
+
+    Queue<u64>* queue = (Queue<u64>*)arg;
+    u64 sum = 0;
+    u64 batch[BATCH_SIZE];
+
+    for (u64 round = 0;; ++round) {
+        bool finished = test_queue_producers_left == 0;
+        usize count = round % 2 ? queue->try_pop_many(Slice<u64>{batch, BATCH_SIZE}) : queue->try_pop(batch);
+        for (usize j = 0; j < count; ++j) {
+            Assert(batch[j]);
+            sum += batch[j];
+        }
+        if (count == 0) {
+            if (finished) break;
+            sched_yield();
+        }
+    }
+
+    return (void*)(u64)sum;
+}
+
+void test_queue() {
+    for (int round = 0; round < 4; ++round) {
+        ScratchArena scratch{};
+
+        test_queue_start = false;
+        test_queue_producers_left = PRODUCER_COUNT;
+
+        // deliberately small so producers keep running into a full queue.
+        Queue<u64> queue = Queue<u64>::make(scratch.arena, 256);
+
+        pthread_t producers[PRODUCER_COUNT];
+        pthread_t consumers[CONSUMER_COUNT];
+        for (u64 i = 0; i < CONSUMER_COUNT; ++i) {
+            pthread_create(&consumers[i], NULL, test_queue_pop_thread, (void*)&queue);
+        }
+        for (u64 i = 0; i < PRODUCER_COUNT; ++i) {
+            pthread_create(&producers[i], NULL, test_queue_push_thread, (void*)&queue);
+        }
+
+        test_queue_start = true;
+
+        for (u64 i = 0; i < PRODUCER_COUNT; ++i) {
+            pthread_join(producers[i], NULL);
+        }
+        u64 sum = 0;
+        for (u64 i = 0; i < CONSUMER_COUNT; ++i) {
+            void* result;
+            pthread_join(consumers[i], &result);
+            sum += (u64)result;
+        }
+
+        u64 expected_sum = (u64)PRODUCER_COUNT * ((u64)NUM_ITEMS * (NUM_ITEMS + 1)) / 2;
+        AssertM(sum == expected_sum, "expected %llu but got %llu\n", expected_sum, sum);
+    }
+
+    // the smallest queues still have to refuse a push rather than overwrite.
+    for (usize capacity = 0; capacity < 3; ++capacity) {
+        ScratchArena scratch{};
+        Queue<u64> queue = Queue<u64>::make(scratch.arena, capacity);
+        Assert(queue.capacity() == 2);
+
+        for (u64 lap = 0; lap < 3; ++lap) {
+            u64 a = lap * 2 + 1, b = lap * 2 + 2, c = 0;
+            Assert(queue.try_push(&a) && queue.try_push(&b) && !queue.try_push(&c));
+            Assert(queue.try_pop(&c) && c == a);
+            Assert(queue.try_pop(&c) && c == b);
+            Assert(!queue.try_pop(&c));
+        }
+    }
+}
+
+#undef PRODUCER_COUNT
+#undef CONSUMER_COUNT
+#undef NUM_ITEMS
+#undef BATCH_SIZE
+
+#define THREAD_COUNT 8
+#define NUM_ITEMS 65536
+
+void* test_queue_throughput_queue_push(void* arg) {
+    while (!test_queue_start);
+
+    Queue<u64>* queue = (Queue<u64>*)arg;
+    for (u64 i = 1; i <= NUM_ITEMS; ++i) {
+        while (!queue->try_push(&i)) sched_yield();
+    }
+    return nullptr;
+}
+
+void* test_queue_throughput_channel_push(void* arg) {
+    while (!test_queue_start);
+
+    Channel<u64>* chan = (Channel<u64>*)arg;
+    for (u64 i = 1; i <= NUM_ITEMS; ++i) {
+        chan->push(&i);
+    }
+    return nullptr;
+}
+
+// same many-to-one shape for both, since that's all Channel supports. the queue
+// is kept smaller than the total so it has to recycle slots like it would in use.
+void test_queue_throughput() {
+    ScratchArena scratch{};
+    u64 total = (u64)THREAD_COUNT * NUM_ITEMS;
+    u64 expected_sum = (u64)THREAD_COUNT * ((u64)NUM_ITEMS * (NUM_ITEMS + 1)) / 2;
+    pthread_t threads[THREAD_COUNT];
+
+    {
+        Queue<u64> queue = Queue<u64>::make(scratch.arena, 16384);
+        test_queue_start = false;
+        for (u64 i = 0; i < THREAD_COUNT; ++i) {
+            pthread_create(&threads[i], NULL, test_queue_throughput_queue_push, (void*)&queue);
+        }
+
+        u64 start_ticks = timing_get_ticks();
+        test_queue_start = true;
+        u64 sum = 0;
+        u64 batch[64];
+        for (u64 received = 0; received < total;) {
+            usize count = queue.try_pop_many(Slice<u64>{batch, 64});
+            if (count == 0) sched_yield();
+            for (usize j = 0; j < count; ++j) sum += batch[j];
+            received += count;
+        }
+        u64 ticks = timing_get_ticks() - start_ticks;
+
+        for (u64 i = 0; i < THREAD_COUNT; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        AssertM(sum == expected_sum, "expected %llu but got %llu\n", expected_sum, sum);
+        test_report_throughput("queue", total, ticks);
+    }
+    {
+        Channel<u64> chan = Channel<u64>::make(scratch.arena, total);
+        test_queue_start = false;
+        for (u64 i = 0; i < THREAD_COUNT; ++i) {
+            pthread_create(&threads[i], NULL, test_queue_throughput_channel_push, (void*)&chan);
+        }
+
+        u64 start_ticks = timing_get_ticks();
+        test_queue_start = true;
+        u64 sum = 0;
+        for (u64 received = 0; received < total;) {
+            usize received_before = received;
+            foreach (it, chan.drain()) {
+                sum += *it.item;
+                received++;
+            }
+            if (received == received_before) sched_yield();
+        }
+        u64 ticks = timing_get_ticks() - start_ticks;
+
+        for (u64 i = 0; i < THREAD_COUNT; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        AssertM(sum == expected_sum, "expected %llu but got %llu\n", expected_sum, sum);
+        test_report_throughput("channel", total, ticks);
+    }
+}
+
+#undef THREAD_COUNT
+#undef NUM_ITEMS
+
+#define NUM_BYTES (64 * 1024 * 1024)
+
+// bytes follow a simple pattern so the consumer can check nothing was dropped,
+// duplicated or reordered, in odd sized pieces so reservations keep wrapping.
+void* test_ring_produce_thread(void* arg) {
+    Ring<u8>* ring = (Ring<u8>*)arg;
+    u64 written = 0;
+    for (u64 i = 0; written < NUM_BYTES; ++i) {
+        Slice<u8> dest = ring->reserve(min((u64)(1 + i % 1021), NUM_BYTES - written));
+        if (dest.count == 0) {
+            sched_yield();
+            continue;
+        }
+        for (usize j = 0; j < dest.count; ++j) {
+            dest.elems[j] = (u8)((written + j) * 7);
+        }
+        ring->commit(dest.count);
+        written += dest.count;
+    }
+    return nullptr;
+}
+
+void test_ring() {
+    ScratchArena scratch{};
+
+    Ring<u8> ring = Ring<u8>::make(scratch.arena, 64_kb);
+
+    pthread_t producer;
+    u64 start_ticks = timing_get_ticks();
+    pthread_create(&producer, NULL, test_ring_produce_thread, (void*)&ring);
+
+    for (u64 read = 0; read < NUM_BYTES;) {
+        Slice<u8> src = ring.peek();
+        if (src.count == 0) {
+            sched_yield();
+            continue;
+        }
+        for (usize j = 0; j < src.count; ++j) {
+            AssertM(src.elems[j] == (u8)((read + j) * 7), "ring corrupted at byte %llu", read + j);
+        }
+        ring.release(src.count);
+        read += src.count;
+    }
+
+    pthread_join(producer, NULL);
+    test_report_throughput("ring bytes", NUM_BYTES, timing_get_ticks() - start_ticks);
+}
+
+#undef NUM_BYTES
+#endif
+// -----------------------------------------------------------------------------
+}  // namespace a
@@ -0,0 +1,90 @@
+#pragma once
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+
+// Bounded multi-producer multi-consumer queue
+//
+// A ring of slots each carrying a sequence number which says whether the slot
+// is waiting for the producer or the consumer of a given lap around the ring,
+// so producers and consumers only ever contend on their own end's counter.
+// Nothing blocks: a push onto a full queue or a pop from an empty one fails
+// and leaves it to the caller to back off or do something else.
+
+forall(T) class Queue {
+    struct Slot {
+        AtomicVal<u64> seq;
+        T item;
+    };
+
+    Slot* slots;
+    u64 mask;
+    alignas(CACHE_LINE_SIZE) AtomicVal<u64> push_pos;
+    alignas(CACHE_LINE_SIZE) AtomicVal<u64> pop_pos;
+
+  public:
+    // capacity is rounded up to a power of two, and at least 2 since a single
+    // slot can't tell a filled slot from one that's free for the next lap.
+    func Queue make(Arena* arena, usize capacity);
+
+    usize capacity() { return mask + 1; }
+
+    bool try_push(T* item);
+    bool try_pop(T* out);
+
+    // move as many items as fit in one claim on the queue, returning the count.
+    usize try_push_many(Slice<T> items);
+    usize try_pop_many(Slice<T> out);
+
+  private:
+    u64 claim(AtomicVal<u64>* pos, u64 lap_offset, usize max_count, usize* count);
+};
+
+// -----------------------------------------------------------------------------
+
+// Single-producer single-consumer ring buffer
+//
+// The producer writes straight into the ring through the slice reserve hands
+// back and publishes it with commit, and the consumer reads it in place with
+// peek and hands the space back with release, so nothing is copied on the way
+// through. Each side keeps a cached copy of the other's position and only
+// reloads it when the cached one says the ring is full or empty, so in steady
+// state the two threads rarely touch each other's cache lines.
+
+forall(T) class Ring {
+    T* elems;
+    u64 mask;
+
+    alignas(CACHE_LINE_SIZE) AtomicVal<u64> write_pos;
+    u64 cached_read_pos;
+
+    alignas(CACHE_LINE_SIZE) AtomicVal<u64> read_pos;
+    u64 cached_write_pos;
+
+  public:
+    // capacity is rounded up to a power of two.
+    func Ring make(Arena* arena, usize capacity);
+
+    usize capacity() { return mask + 1; }
+
+    // producer side. the slice holds up to count free slots, fewer if the ring
+    // is nearly full or the free space wraps around the end of the buffer.
+    Slice<T> reserve(usize count);
+    void commit(usize count);
+
+    // consumer side. peek returns everything committed that's contiguous in the
+    // buffer, which stays valid until it's released.
+    Slice<T> peek();
+    void release(usize count);
+};
+
+// -----------------------------------------------------------------------------
+
+#if TEST
+void test_queue();
+void test_queue_throughput();
+void test_ring();
+#endif
+
+// -----------------------------------------------------------------------------
+}  // namespace a
@@ -156,6 +156,8 @@ typedef simde_float64x2_t f64x2;
 
 #define u8x8_nonzero_lane(x) (u64_count_leading_zeroes(u64_from_u8x8(u8x8_reverse64(x))) / 8)
 #define u8x16_nonzero_lane(x) (u64_count_leading_zeroes(u64_bit_reverse(u64_from_u8x8(u16x8_shrn(u16x8_from_u8x16(x), 4)))) / 4)
+// one bit per lane of a u8x16 comparison result, lane i at bit 4 * i + 3.
+#define u8x16_lane_bits(x) (u64_from_u8x8(u16x8_shrn(u16x8_from_u8x16(x), 4)) & 0x8888888888888888ull)
 #define u8x16_shift_lanes(x, n) (u8x16_extract((x), u8x16_splat(0), (n)))
 
 // --- 16-bit ---
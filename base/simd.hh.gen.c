@@ -150,6 +150,8 @@ int main(void) {
     out += sprintf(out, "\n");
     out += sprintf(out, "#define u8x8_nonzero_lane(x)    (u64_count_leading_zeroes(u64_from_u8x8(u8x8_reverse64(x))) / 8)\n");
     out += sprintf(out, "#define u8x16_nonzero_lane(x)   (u64_count_leading_zeroes(u64_bit_reverse(u64_from_u8x8(u16x8_shrn(u16x8_from_u8x16(x), 4)))) / 4)\n");
+    out += sprintf(out, "// one bit per lane of a u8x16 comparison result, lane i at bit 4 * i + 3.\n");
+    out += sprintf(out, "#define u8x16_lane_bits(x)      (u64_from_u8x8(u16x8_shrn(u16x8_from_u8x16(x), 4)) & 0x8888888888888888ull)\n");
     out += sprintf(out, "#define u8x16_shift_lanes(x, n) (u8x16_extract((x), u8x16_splat(0), (n)))\n");
 
     out += sprintf(out, "\n// --- 16-bit ---\n\n");
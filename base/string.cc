@@ -8,12 +8,11 @@ namespace a {
             printf(marker, value);                                                             \
             return;                                                                            \
         }                                                                                      \
-        u8* arena_start = out->cur;                                                            \
         /* re 256: doesn't need to be very big since this function handles printing individual \
            literal values and strings are handled separately. */                               \
-        Slice<char> out_buffer = out->push_many<char>(256);                                    \
+        Slice<char> out_buffer = out->push_many_uninit<char>(256);                             \
         int written = snprintf(out_buffer.elems, out_buffer.count, marker, value);             \
-        out->cur = arena_start + written;                                                      \
+        out->cur = (u8*)out_buffer.elems + written;                                            \
     }
 ImplPrintValue(i8, "%i");
 ImplPrintValue(u8, "%u");
@@ -37,7 +36,7 @@ ImplPrintValue(double, "%f");
             printf("%.*s", len, value);                            \
             return;                                                \
         }                                                          \
-        Slice<char> out_buffer = out->push_many<char>(len);        \
+        Slice<char> out_buffer = out->push_many_uninit<char>(len); \
         MemCopy(out_buffer.elems, value, len);                     \
     }
 ImplPrintValueStr(char*);
@@ -91,7 +90,7 @@ void print_value(Arena* out, Str value) {
         printf("%.*s", (int)value.count, value.elems);
         return;
     }
-    Slice<char> out_buf = out->push_many<char>(value.count);
+    Slice<char> out_buf = out->push_many_uninit<char>(value.count);
     MemCopy(out_buf.elems, value.elems, value.count);
 }
 
@@ -119,7 +118,7 @@ Slice<char> Str::to_slice() {
 }
 
 char* Str::to_cstr(Arena* arena) {
-    char* ret = arena->push_many<char>(count + 1).elems;
+    char* ret = arena->push_many_uninit<char>(count + 1).elems;
     ArrayCopy(ret, elems, count);
     ret[count] = 0;
     return ret;
@@ -276,7 +275,7 @@ Str Str::join(Arena* out, Slice<Str> strings, char join) {
 }
 
 Str Str::clone(Arena* arena) {
-    Slice<char> cloned = arena->push_many<char>(count);
+    Slice<char> cloned = arena->push_many_uninit<char>(count);
     ArrayCopy(cloned.elems, elems, count);
     return Str::from_slice_char(cloned);
 }
@@ -0,0 +1,274 @@
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+#define Template template <typename K, typename V, bool PREHASHED, bool VERIFY_KEYS>
+#define This SwissHashArray_<K, V, PREHASHED, VERIFY_KEYS>
+
+Template This This::make(Arena* arena, u64 capacity, u64 max_elems) {
+    u8* ctrl = (u8*)arena->push_many<u8x16>(capacity / GROUP_SIZE).elems;
+    K* keys = arena->push_many<K>(capacity).elems;
+    V* values = arena->push_many<V>(capacity).elems;
+    V* value_stub = arena->push<V>();
+
+    This map = {};
+
+    map.capacity = capacity;
+    map.max_elems = max_elems;
+    map.group_mask = capacity / GROUP_SIZE - 1;
+
+    map.count = 0;
+    map.ctrl = ctrl;
+    map.keys = keys;
+    map.values = values;
+    map.value_stub = value_stub;
+
+    return map;
+}
+
+Template This This::make_with_cap(Arena* arena, u64 capacity) {
+    capacity = max((u64)next_power_of_2(capacity), (u64)GROUP_SIZE);
+    u64 max_elems = capacity * LOAD_FACTOR_PERCENT / 100;
+    return This::make(arena, capacity, max_elems);
+}
+
+Template This This::make_with_elems(Arena* arena, u64 max_elems) {
+    u64 capacity = max((u64)next_power_of_2(max_elems * 100 / LOAD_FACTOR_PERCENT), (u64)GROUP_SIZE);
+    return This::make(arena, capacity, max_elems);
+}
+
+Template u64 This::hash_key(K* key) {
+    if constexpr (PREHASHED) {
+        return key->hash;
+    } else {
+        return hash64_bytes((u8*)key, sizeof(K));
+    }
+}
+
+// the group index comes from the low bits of the hash, so the tag takes the top 7.
+Template u8 This::ctrl_tag(u64 hash) {
+    return CTRL_FULL | (u8)(hash >> 57);
+}
+
+Template u64 This::match_mask(u8* group, u8 value) {
+    return u8x16_lane_bits(u8x16_equal(u8x16_load(group), u8x16_splat(value)));
+}
+
+Template bool This::keys_equal(K* a, K* b) {
+    if constexpr (!VERIFY_KEYS) {
+        static_assert(PREHASHED, "unverified keys must be prehashed");
+        return a->hash == b->hash;
+    } else if constexpr (requires { a->eq(b); }) {
+        return a->eq(b);
+    } else {
+        return memcmp(a, b, sizeof(K)) == 0;
+    }
+}
+
+Template u64 This::find_idx(K* key, u64 hash) {
+    u8 tag = ctrl_tag(hash);
+    u64 group = hash & group_mask;
+
+    for (u64 probe = 1; probe <= group_mask + 1; ++probe) {
+        u8* group_ctrl = &ctrl[group * GROUP_SIZE];
+
+        for (u64 mask = match_mask(group_ctrl, tag); mask; mask &= mask - 1) {
+            u64 i = group * GROUP_SIZE + count_trailing_zeroes(mask) / 4;
+            if (keys_equal(&keys[i], key)) return i;
+        }
+        if (match_mask(group_ctrl, CTRL_EMPTY)) return UINT64_MAX;
+
+        group = (group + probe) & group_mask;
+    }
+
+    return UINT64_MAX;
+}
+
+Template u64 This::find_free_idx(u64 hash) {
+    u64 group = hash & group_mask;
+
+    for (u64 probe = 1; probe <= group_mask + 1; ++probe) {
+        u8* group_ctrl = &ctrl[group * GROUP_SIZE];
+
+        u64 mask = match_mask(group_ctrl, CTRL_EMPTY) | match_mask(group_ctrl, CTRL_DELETED);
+        if (mask) return group * GROUP_SIZE + count_trailing_zeroes(mask) / 4;
+
+        group = (group + probe) & group_mask;
+    }
+
+    AssertUnreachable();
+}
+
+Template V* This::fill(u64 idx, u64 hash, K* key) {
+    count++;
+    ctrl[idx] = ctrl_tag(hash);
+    keys[idx] = *key;
+
+    V* value = &values[idx];
+    return ZeroStruct(value);
+}
+
+Template V* This::insert(K* key) {
+    AssertM(count < max_elems, "hasharray is full");
+
+    u64 hash = hash_key(key);
+    return fill(find_free_idx(hash), hash, key);
+}
+
+Template V* This::maybe_get(K* key) {
+    u64 i = find_idx(key, hash_key(key));
+    return i == UINT64_MAX ? nullptr : &values[i];
+}
+
+Template V* This::get(K* key) {
+    u64 i = find_idx(key, hash_key(key));
+    return i == UINT64_MAX ? value_stub : &values[i];
+}
+
+Template V* This::entry(K* key) {
+    u64 hash = hash_key(key);
+
+    u64 i = find_idx(key, hash);
+    if (i < UINT64_MAX) return &values[i];
+
+    AssertM(count < max_elems, "hasharray is full");
+    return fill(find_free_idx(hash), hash, key);
+}
+
+// A group that still has an empty slot has never been full, so no probe has
+// ever gone past it and the removed slot can go straight back to empty.
+Template bool This::remove(K* key) {
+    u64 i = find_idx(key, hash_key(key));
+    if (i == UINT64_MAX) return false;
+
+    u8* group_ctrl = &ctrl[i & ~(u64)(GROUP_SIZE - 1)];
+
+    count--;
+    ctrl[i] = match_mask(group_ctrl, CTRL_EMPTY) ? CTRL_EMPTY : CTRL_DELETED;
+    return true;
+}
+
+Template void This::clear() {
+    count = 0;
+    ZeroArray(ctrl, capacity);
+}
+
+Template This::Iter This::Iter::make(This* map) {
+    This::Iter ret = {};
+    ret.idx = -1;
+    ret.target = map;
+    ret.next();
+    return ret;
+}
+
+Template void This::Iter::next() {
+    idx = wrapped_add(idx, 1ull);
+    for (;;) {
+        if (idx >= target->capacity) {
+            done = true;
+            return;
+        }
+        if (target->ctrl[idx] & CTRL_FULL) {
+            key = &target->keys[idx];
+            item = &target->values[idx];
+            return;
+        }
+        ++idx;
+    }
+}
+
+#undef Template
+#undef This
+// -----------------------------------------------------------------------------
+#if TEST
+
+struct TestSwissHashCollidingKey {
+    u64 hash;
+    u64 id;
+};
+
+struct TestSwissHashStrKey {
+    u64 hash;
+    cchar* str;
+
+    bool eq(TestSwissHashStrKey* other) { return strcmp(str, other->str) == 0; }
+};
+
+void test_swisshash() {
+    ScratchArena scratch{};
+
+    // a few distinct hashes between all the keys fill whole groups with the same tag.
+    SwissPreHashArray<TestSwissHashCollidingKey, u64> colliding = SwissPreHashArray<TestSwissHashCollidingKey, u64>::make_with_elems(scratch.arena, 1000);
+    for (u64 i = 0; i < 1000; ++i) {
+        TestSwissHashCollidingKey key = {i % 4, i};
+        *colliding.entry(&key) = i * 10;
+    }
+    Assert(colliding.count == 1000);
+    for (u64 i = 0; i < 1000; i += 2) {
+        TestSwissHashCollidingKey key = {i % 4, i};
+        Assert(colliding.remove(&key));
+    }
+    for (u64 i = 0; i < 1000; ++i) {
+        TestSwissHashCollidingKey key = {i % 4, i};
+        u64* value = colliding.maybe_get(&key);
+        bool kept = i & 1;
+        AssertM(kept ? value && *value == i * 10 : !value, "removing colliding key %llu went wrong", i);
+    }
+    for (u64 i = 0; i < 1000; i += 2) {
+        TestSwissHashCollidingKey key = {i % 4, i};
+        *colliding.entry(&key) = i;
+    }
+    u64 iterated = 0;
+    foreach (it, colliding.iter()) {
+        AssertM(*it.item == (it.key->id & 1 ? it.key->id * 10 : it.key->id), "wrong value for key %llu", it.key->id);
+        iterated++;
+    }
+    Assert(iterated == 1000 && colliding.count == 1000);
+
+    char buffers[2][8] = {"apple", "apple"};
+    SwissPreHashArray<TestSwissHashStrKey, u32> strs = SwissPreHashArray<TestSwissHashStrKey, u32>::make_with_elems(scratch.arena, 16);
+    TestSwissHashStrKey apple = {7, buffers[0]};
+    TestSwissHashStrKey apple_copy = {7, buffers[1]};
+    TestSwissHashStrKey pear = {7, "pear"};
+    *strs.entry(&apple) = 1;
+    *strs.entry(&pear) = 2;
+    Assert(*strs.get(&apple_copy) == 1 && *strs.get(&pear) == 2 && strs.count == 2);
+
+    UniqueSwissPreHashArray<TestSwissHashCollidingKey, u64> unique = UniqueSwissPreHashArray<TestSwissHashCollidingKey, u64>::make_with_elems(scratch.arena, 16);
+    TestSwissHashCollidingKey a = {42, 1}, b = {42, 2};
+    *unique.entry(&a) = 1;
+    Assert(*unique.get(&b) == 1);
+
+    // lookups against HashArray at the same element count, half of them misses.
+    konst u64 NUM_KEYS = 1 << 16;
+    konst u64 NUM_LOOKUPS = 1 << 22;
+
+    HashArray<u64, u64> linear = HashArray<u64, u64>::make_with_elems(scratch.arena, NUM_KEYS);
+    SwissHashArray<u64, u64> swiss = SwissHashArray<u64, u64>::make_with_elems(scratch.arena, NUM_KEYS);
+    for (u64 i = 0; i < NUM_KEYS; ++i) {
+        u64 key = i * 2;
+        *linear.insert(&key) = i;
+        *swiss.insert(&key) = i;
+    }
+
+    u64 linear_hits = 0, swiss_hits = 0;
+
+    u64 start_ticks = timing_get_ticks();
+    for (u64 i = 0; i < NUM_LOOKUPS; ++i) {
+        u64 key = (i * 0x9e3779b97f4a7c15ull) & (NUM_KEYS * 2 - 1);
+        linear_hits += linear.maybe_get(&key) != nullptr;
+    }
+    test_report_throughput("hasharray lookups", NUM_LOOKUPS, timing_get_ticks() - start_ticks);
+
+    start_ticks = timing_get_ticks();
+    for (u64 i = 0; i < NUM_LOOKUPS; ++i) {
+        u64 key = (i * 0x9e3779b97f4a7c15ull) & (NUM_KEYS * 2 - 1);
+        swiss_hits += swiss.maybe_get(&key) != nullptr;
+    }
+    test_report_throughput("swisshash lookups", NUM_LOOKUPS, timing_get_ticks() - start_ticks);
+
+    Assert(linear_hits == swiss_hits && swiss_hits > 0);
+}
+
+#endif
+// -----------------------------------------------------------------------------
+}  // namespace a
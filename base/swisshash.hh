@@ -0,0 +1,87 @@
+#pragma once
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+#define Template template <typename K, typename V, bool PREHASHED, bool VERIFY_KEYS>
+
+// Same map as HashArray_, laid out Swiss-table style for lookup heavy use. Each
+// slot gets one control byte, holding 7 bits of its key's hash when it's full,
+// and the control bytes are probed a group of 16 slots at a time with SIMD, so
+// a lookup usually touches one 16 byte group plus the key it's looking for.
+// Groups are visited in triangular order, which covers every group since the
+// group count is a power of 2. Key comparison follows HashArray_, except that
+// with VERIFY_KEYS off only the prehashed hash members are compared.
+
+Template class SwissHashArray_ {
+    konst u32 LOAD_FACTOR_PERCENT = 87;
+    konst u32 GROUP_SIZE = 16;
+
+    konst u8 CTRL_EMPTY = 0x00;
+    konst u8 CTRL_DELETED = 0x01;
+    konst u8 CTRL_FULL = 0x80;
+
+    u8* ctrl;
+    K* keys;
+    V* values;
+    V* value_stub;
+    u64 group_mask;
+
+  public:
+    u64 capacity;
+    u64 max_elems;
+    u64 count;
+
+    class Iter {
+        u64 idx;
+        SwissHashArray_* target;
+
+      public:
+        K* key;
+        V* item;
+        bool done;
+
+        func Iter make(SwissHashArray_* map);
+        void next();
+    };
+
+    func SwissHashArray_ make_with_cap(Arena* arena, u64 capacity);
+    func SwissHashArray_ make_with_elems(Arena* arena, u64 max_elems);
+
+    V* insert(K* key);
+    V* maybe_get(K* key);
+    V* get(K* key);
+    V* entry(K* key);
+    bool remove(K* key);
+    void clear();
+
+    Iter iter() { return Iter::make(this); }
+
+  private:
+    func SwissHashArray_ make(Arena* arena, u64 capacity, u64 max_elems);
+    func u64 hash_key(K* key);
+    func u8 ctrl_tag(u64 hash);
+    func u64 match_mask(u8* group, u8 value);
+    func bool keys_equal(K* a, K* b);
+
+    u64 find_idx(K* key, u64 hash);
+    u64 find_free_idx(u64 hash);
+    V* fill(u64 idx, u64 hash, K* key);
+};
+
+template <typename K, typename V>
+using SwissHashArray = SwissHashArray_<K, V, false, true>;
+
+template <typename K, typename V>
+using SwissPreHashArray = SwissHashArray_<K, V, true, true>;
+
+template <typename K, typename V>
+using UniqueSwissPreHashArray = SwissHashArray_<K, V, true, false>;
+
+#undef Template
+// -----------------------------------------------------------------------------
+
+#if TEST
+void test_swisshash();
+#endif
+// -----------------------------------------------------------------------------
+}  // namespace a
@@ -0,0 +1,66 @@
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+
+#if PLATFORM_APPLE
+
+// private but stable, it's what libc++ builds std::atomic::wait on.
+extern "C" int __ulock_wait(u32 operation, void* addr, u64 value, u32 timeout_micros);
+extern "C" int __ulock_wake(u32 operation, void* addr, u64 wake_value);
+konst u32 ULOCK_COMPARE_AND_WAIT = 1;
+konst u32 ULOCK_WAKE_ALL = 0x00000100;
+konst u32 ULOCK_NO_ERRNO = 0x01000000;
+
+void futex_wait(AtomicVal<u32>* addr, u32 expected) {
+    __ulock_wait(ULOCK_COMPARE_AND_WAIT | ULOCK_NO_ERRNO, addr->ptr(), expected, 0);
+}
+
+void futex_wake_one(AtomicVal<u32>* addr) {
+    __ulock_wake(ULOCK_COMPARE_AND_WAIT | ULOCK_NO_ERRNO, addr->ptr(), 0);
+}
+
+void futex_wake_all(AtomicVal<u32>* addr) {
+    __ulock_wake(ULOCK_COMPARE_AND_WAIT | ULOCK_WAKE_ALL | ULOCK_NO_ERRNO, addr->ptr(), 0);
+}
+
+#else
+
+void futex_wait(AtomicVal<u32>* addr, u32 expected) {
+    syscall(SYS_futex, addr->ptr(), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+void futex_wake_one(AtomicVal<u32>* addr) {
+    syscall(SYS_futex, addr->ptr(), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+void futex_wake_all(AtomicVal<u32>* addr) {
+    syscall(SYS_futex, addr->ptr(), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+#endif
+
+void cpu_relax() {
+#if defined(__aarch64__)
+    __asm__ volatile("yield");
+#elif defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+void SpinLock::lock() {
+    for (;;) {
+        if (!::std::atomic_exchange_explicit(locked.ptr(), 1, ::std::memory_order_acquire)) return;
+        while (::std::atomic_load_explicit(locked.ptr(), ::std::memory_order_relaxed)) {
+            cpu_relax();
+        }
+    }
+}
+
+void SpinLock::unlock() {
+    ::std::atomic_store_explicit(locked.ptr(), 0, ::std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+}  // namespace a
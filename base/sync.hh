@@ -0,0 +1,27 @@
+#pragma once
+#include "inc.hh"
+namespace a {
+// -----------------------------------------------------------------------------
+
+// Sleeping on the value of an atomic, for the slow paths of otherwise lock-free
+// structures. futex_wait returns once woken, or straight away if the value no
+// longer matches expected, and may also wake spuriously, so callers re-check
+// whatever they were waiting for in a loop.
+
+void futex_wait(AtomicVal<u32>* addr, u32 expected);
+void futex_wake_one(AtomicVal<u32>* addr);
+void futex_wake_all(AtomicVal<u32>* addr);
+
+// hint to the core that we're in a spin loop.
+void cpu_relax();
+
+// for short critical sections that are rarely contended.
+struct SpinLock {
+    AtomicVal<u32> locked;
+
+    void lock();
+    void unlock();
+};
+
+// -----------------------------------------------------------------------------
+}  // namespace a
@@ -10,13 +10,40 @@ void x_test_run(cchar* name, void (*fn)(void)) {
     fprintf(stderr, "\t- completed in %llu μs\n", timing_ticks_to_nanos(finish_ticks - start_ticks) / 1000);
 }
 
+void test_report_throughput(cchar* label, u64 items, u64 ticks) {
+    u64 nanos = max(timing_ticks_to_nanos(ticks), 1ull);
+    fprintf(stderr, "\n    %-28s %10llu items in %8llu μs, %7.2f M items/s", label, items, nanos / 1000, 1000.0 * (double)items / (double)nanos);
+}
+
 // -----------------------------------------------------------------------------
 
 #if TEST
 void test_base() {
+    test_run(test_arena);
+    test_run(test_shared_arena);
+    test_run(test_chained_arena);
+    test_run(test_thread_scratch);
+    test_run(test_vec);
+    test_run(test_pool);
+    test_run(test_hasharray);
+    test_run(test_swisshash);
+    test_run(test_atomichash);
     test_run(test_channel);
+    test_run(test_channel_backpressure);
+    test_run(test_channel_drain_wait);
+    test_run(test_channel_contention);
+    test_run(test_segmented_channel);
+    test_run(test_queue);
+    test_run(test_queue_throughput);
+    test_run(test_ring);
+    test_run(test_jobs);
+    test_run(test_parallel);
     test_run(test_formats);
 }
+
+void bench_base() {
+    bench_channel();
+}
 #endif
 
 // -----------------------------------------------------------------------------
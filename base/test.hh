@@ -6,10 +6,14 @@ namespace a {
 #define test_run(name) x_test_run(#name, name)
 void x_test_run(cchar* name, void (*fn)(void));
 
+// prints a line under the running test with the rate items were processed at.
+void test_report_throughput(cchar* label, u64 items, u64 ticks);
+
 // -----------------------------------------------------------------------------
 
 #if TEST
 void test_base();
+void bench_base();
 #endif
 
 // -----------------------------------------------------------------------------